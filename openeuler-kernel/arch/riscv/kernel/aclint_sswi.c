@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * IPIs through the ACLINT supervisor software interrupt device (SSWI).
+ *
+ * Writing 1 to the SETSSIP register of a hart raises its supervisor
+ * software interrupt directly, so sending an IPI no longer takes an SBI
+ * call and a second trip through M-mode on the receiving side. Harts
+ * without an SSWI register are still reached through SBI.
+ *
+ * A register is only used while its CPU is online. Harts dedicated to
+ * an enclave are taken offline first, so IPIs to them always go through
+ * SBI, where the firmware drops them, instead of hitting the enclave.
+ */
+
+#include <linux/cpuhotplug.h>
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/io.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/of_irq.h>
+#include <linux/percpu.h>
+#include <asm/csr.h>
+#include <asm/sbi.h>
+#include <asm/smp.h>
+
+/* One 32-bit SETSSIP register per interrupts-extended entry */
+#define ACLINT_SSWI_REG_SIZE		4
+
+/* Register of every CPU found in the device tree */
+static DEFINE_PER_CPU(void __iomem *, aclint_sswi_base);
+/* Same, but only while the CPU is online */
+static DEFINE_PER_CPU(void __iomem *, aclint_sswi_reg);
+
+static void aclint_sswi_inject(const struct cpumask *target)
+{
+	struct cpumask hartid_mask;
+	bool fallback = false;
+	void __iomem *reg;
+	int cpu;
+
+	cpumask_clear(&hartid_mask);
+	for_each_cpu(cpu, target) {
+		reg = READ_ONCE(per_cpu(aclint_sswi_reg, cpu));
+		if (reg) {
+			/* Orders the ipi_data update before the interrupt */
+			writel(1, reg);
+		} else {
+			cpumask_set_cpu(cpuid_to_hartid_map(cpu), &hartid_mask);
+			fallback = true;
+		}
+	}
+
+	if (fallback)
+		sbi_send_ipi(cpumask_bits(&hartid_mask));
+}
+
+static struct riscv_ipi_ops aclint_sswi_ipi_ops = {
+	.ipi_inject = aclint_sswi_inject
+};
+
+static int __init aclint_sswi_hartid_to_cpu(int hartid)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (cpuid_to_hartid_map(cpu) == hartid)
+			return cpu;
+
+	return -ENODEV;
+}
+
+/* Returns the number of CPUs reachable through this device */
+static int __init aclint_sswi_probe(struct device_node *np)
+{
+	struct of_phandle_args parent;
+	void __iomem *base;
+	int i, hartid, cpu, nr = 0;
+
+	base = of_iomap(np, 0);
+	if (!base) {
+		pr_warn("%pOFP: could not map registers\n", np);
+		return 0;
+	}
+
+	for (i = 0; !of_irq_parse_one(np, i, &parent); i++) {
+		hartid = riscv_of_parent_hartid(parent.np);
+		of_node_put(parent.np);
+		if (parent.args[0] != IRQ_S_SOFT || hartid < 0)
+			continue;
+
+		cpu = aclint_sswi_hartid_to_cpu(hartid);
+		if (cpu < 0)
+			continue;
+
+		per_cpu(aclint_sswi_base, cpu) = base + i * ACLINT_SSWI_REG_SIZE;
+		nr++;
+	}
+
+	if (!nr)
+		iounmap(base);
+
+	return nr;
+}
+
+static int aclint_sswi_cpu_online(unsigned int cpu)
+{
+	WRITE_ONCE(per_cpu(aclint_sswi_reg, cpu),
+		   per_cpu(aclint_sswi_base, cpu));
+
+	return 0;
+}
+
+static int aclint_sswi_cpu_offline(unsigned int cpu)
+{
+	WRITE_ONCE(per_cpu(aclint_sswi_reg, cpu), NULL);
+
+	return 0;
+}
+
+/* Before SMP bring-up, which already needs IPIs */
+static int __init aclint_sswi_init(void)
+{
+	struct device_node *np;
+	int nr = 0, ret;
+
+	for_each_compatible_node(np, NULL, "riscv,aclint-sswi")
+		nr += aclint_sswi_probe(np);
+
+	if (!nr)
+		return 0;
+
+	/* Secondary CPUs are reached through SBI until they are online */
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "riscv/aclint_sswi:online",
+				aclint_sswi_cpu_online,
+				aclint_sswi_cpu_offline);
+	if (ret < 0) {
+		pr_warn("ACLINT SSWI: hotplug setup failed (%d)\n", ret);
+		return 0;
+	}
+
+	riscv_set_ipi_ops(&aclint_sswi_ipi_ops);
+	pr_info("ACLINT SSWI: direct IPIs to %d of %d CPUs\n", nr,
+		num_possible_cpus());
+
+	return 0;
+}
+early_initcall(aclint_sswi_init);
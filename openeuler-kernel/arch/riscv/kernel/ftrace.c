@@ -8,6 +8,7 @@
 #include <linux/ftrace.h>
 #include <linux/uaccess.h>
 #include <linux/memory.h>
+#include <linux/stop_machine.h>
 #include <asm/cacheflush.h>
 #include <asm/patch.h>
 
@@ -128,6 +129,44 @@ int ftrace_update_ftrace_func(ftrace_func_t func)
 	return ret;
 }
 
+struct ftrace_modify_param {
+	int command;
+	atomic_t cpu_count;
+};
+
+static int __ftrace_modify_code(void *data)
+{
+	struct ftrace_modify_param *param = data;
+
+	/* Patch once every other CPU is spinning below */
+	if (atomic_inc_return(&param->cpu_count) == num_online_cpus()) {
+		ftrace_modify_all_code(param->command);
+		atomic_inc_return_release(&param->cpu_count);
+	} else {
+		while (atomic_read(&param->cpu_count) <= num_online_cpus())
+			cpu_relax();
+		smp_mb();
+	}
+
+	local_flush_icache_all();
+
+	return 0;
+}
+
+/*
+ * Update every record within a single stop_machine(). The records are
+ * written without any icache flush, each CPU flushes its own icache
+ * once on the way out instead of one remote fence.i per record.
+ */
+void arch_ftrace_update_code(int command)
+{
+	struct ftrace_modify_param param = { command, ATOMIC_INIT(0) };
+
+	riscv_patch_in_stop_machine = true;
+	stop_machine(__ftrace_modify_code, &param, cpu_online_mask);
+	riscv_patch_in_stop_machine = false;
+}
+
 int __init ftrace_dyn_arch_init(void)
 {
 	return 0;
@@ -9,37 +9,134 @@
 #include <linux/memory.h>
 #include <linux/mutex.h>
 #include <asm/bug.h>
+#include <asm/cacheflush.h>
 #include <asm/patch.h>
+#include <asm/sbi.h>
+#include <asm/smp.h>
 
 #define RISCV_INSN_NOP 0x00000013U
 #define RISCV_INSN_JAL 0x0000006fU
 
-void arch_jump_label_transform(struct jump_entry *entry,
-			       enum jump_label_type type)
-{
-	void *addr = (void *)jump_entry_code(entry);
+/* Entries queued between two arch_jump_label_transform_apply() calls */
+#define JUMP_LABEL_BATCH_MAX	(PAGE_SIZE / sizeof(struct jump_label_patch))
+
+struct jump_label_patch {
+	void *addr;
 	u32 insn;
+};
+
+/* Serialized by jump_label_mutex */
+static struct jump_label_patch jump_label_batch[JUMP_LABEL_BATCH_MAX];
+static unsigned int jump_label_batch_nr;
 
+static bool jump_label_insn(struct jump_entry *entry,
+			    enum jump_label_type type, u32 *insn)
+{
 	if (type == JUMP_LABEL_JMP) {
 		long offset = jump_entry_target(entry) - jump_entry_code(entry);
 
 		if (WARN_ON(offset & 1 || offset < -524288 || offset >= 524288))
-			return;
+			return false;
 
-		insn = RISCV_INSN_JAL |
+		*insn = RISCV_INSN_JAL |
 			(((u32)offset & GENMASK(19, 12)) << (12 - 12)) |
 			(((u32)offset & GENMASK(11, 11)) << (20 - 11)) |
 			(((u32)offset & GENMASK(10,  1)) << (21 -  1)) |
 			(((u32)offset & GENMASK(20, 20)) << (31 - 20));
 	} else {
-		insn = RISCV_INSN_NOP;
+		*insn = RISCV_INSN_NOP;
 	}
 
+	return true;
+}
+
+void arch_jump_label_transform(struct jump_entry *entry,
+			       enum jump_label_type type)
+{
+	void *addr = (void *)jump_entry_code(entry);
+	u32 insn;
+
+	if (!jump_label_insn(entry, type, &insn))
+		return;
+
 	mutex_lock(&text_mutex);
 	patch_text_nosync(addr, &insn, sizeof(insn));
 	mutex_unlock(&text_mutex);
 }
 
+/*
+ * Each site is a single aligned instruction, so it can be rewritten while
+ * other harts run it. Queued sites are only written on apply, followed by
+ * one icache flush, which is a single remote fence.i for the whole batch
+ * rather than one per site.
+ */
+#ifdef CONFIG_RISCV_SBI
+/* Let the remote fence.i run while this hart flushes its own icache */
+static void jump_label_flush_icache(void)
+{
+	struct cpumask others, hmask;
+	unsigned long ticket = 0;
+
+	cpumask_copy(&others, cpu_online_mask);
+	cpumask_clear_cpu(get_cpu(), &others);
+	riscv_cpuid_to_hartid_mask(&others, &hmask);
+
+	if (!cpumask_empty(&hmask) &&
+	    sbi_remote_fence_i_async(cpumask_bits(&hmask), &ticket)) {
+		put_cpu();
+		flush_icache_all();
+		return;
+	}
+
+	local_flush_icache_all();
+	put_cpu();
+
+	/* Completion unknown, fall back to a synchronous flush */
+	if (sbi_rfence_ticket_wait(ticket))
+		flush_icache_all();
+}
+#else
+static void jump_label_flush_icache(void)
+{
+	flush_icache_all();
+}
+#endif
+
+bool arch_jump_label_transform_queue(struct jump_entry *entry,
+				     enum jump_label_type type)
+{
+	struct jump_label_patch *patch;
+
+	if (jump_label_batch_nr == JUMP_LABEL_BATCH_MAX)
+		return false;
+
+	patch = &jump_label_batch[jump_label_batch_nr];
+	if (!jump_label_insn(entry, type, &patch->insn))
+		return true;
+
+	patch->addr = (void *)jump_entry_code(entry);
+	jump_label_batch_nr++;
+
+	return true;
+}
+
+void arch_jump_label_transform_apply(void)
+{
+	unsigned int i;
+
+	if (!jump_label_batch_nr)
+		return;
+
+	mutex_lock(&text_mutex);
+	for (i = 0; i < jump_label_batch_nr; i++)
+		patch_text_write(jump_label_batch[i].addr,
+				 &jump_label_batch[i].insn, sizeof(u32));
+	jump_label_flush_icache();
+	mutex_unlock(&text_mutex);
+
+	jump_label_batch_nr = 0;
+}
+
 void arch_jump_label_transform_static(struct jump_entry *entry,
 				      enum jump_label_type type)
 {
@@ -19,6 +19,14 @@ struct patch_insn {
 	atomic_t cpu_count;
 };
 
+/*
+ * Set by the text_mutex holder while every online CPU is held in
+ * stop_machine(). The patching CPU then runs in the stopper thread
+ * without owning text_mutex, and the remote icache flush is left out
+ * because each CPU flushes its own icache before leaving stop_machine().
+ */
+bool riscv_patch_in_stop_machine;
+
 #ifdef CONFIG_MMU
 static void *patch_map(void *addr, int fixmap)
 {
@@ -56,7 +64,8 @@ static int patch_insn_write(void *addr, const void *insn, size_t len)
 	 * already, so we don't need to give another lock here and could
 	 * ensure that it was safe between each cores.
 	 */
-	lockdep_assert_held(&text_mutex);
+	if (!riscv_patch_in_stop_machine)
+		lockdep_assert_held(&text_mutex);
 
 	if (across_pages)
 		patch_map(addr + len, FIX_TEXT_POKE1);
@@ -81,6 +90,16 @@ static int patch_insn_write(void *addr, const void *insn, size_t len)
 NOKPROBE_SYMBOL(patch_insn_write);
 #endif /* CONFIG_MMU */
 
+/*
+ * Write instructions without flushing the icache. Only for callers that
+ * patch many sites in a row and flush once for all of them.
+ */
+int patch_text_write(void *addr, const void *insns, size_t len)
+{
+	return patch_insn_write(addr, insns, len);
+}
+NOKPROBE_SYMBOL(patch_text_write);
+
 int patch_text_nosync(void *addr, const void *insns, size_t len)
 {
 	u32 *tp = addr;
@@ -88,7 +107,7 @@ int patch_text_nosync(void *addr, const void *insns, size_t len)
 
 	ret = patch_insn_write(tp, insns, len);
 
-	if (!ret)
+	if (!ret && !riscv_patch_in_stop_machine)
 		flush_icache_range((uintptr_t) tp, (uintptr_t) tp + len);
 
 	return ret;
@@ -100,17 +119,20 @@ static int patch_text_cb(void *data)
 	struct patch_insn *patch = data;
 	int ret = 0;
 
-	if (atomic_inc_return(&patch->cpu_count) == 1) {
+	if (atomic_inc_return(&patch->cpu_count) == num_online_cpus()) {
 		ret =
 		    patch_text_nosync(patch->addr, &patch->insn,
 					    GET_INSN_LENGTH(patch->insn));
-		atomic_inc(&patch->cpu_count);
+		/* The store must be visible before any CPU flushes */
+		atomic_inc_return_release(&patch->cpu_count);
 	} else {
 		while (atomic_read(&patch->cpu_count) <= num_online_cpus())
 			cpu_relax();
 		smp_mb();
 	}
 
+	local_flush_icache_all();
+
 	return ret;
 }
 NOKPROBE_SYMBOL(patch_text_cb);
@@ -122,8 +144,13 @@ int patch_text(void *addr, u32 insn)
 		.insn = insn,
 		.cpu_count = ATOMIC_INIT(0),
 	};
+	int ret;
+
+	riscv_patch_in_stop_machine = true;
+	ret = stop_machine_cpuslocked(patch_text_cb,
+				      &patch, cpu_online_mask);
+	riscv_patch_in_stop_machine = false;
 
-	return stop_machine_cpuslocked(patch_text_cb,
-				       &patch, cpu_online_mask);
+	return ret;
 }
 NOKPROBE_SYMBOL(patch_text);
@@ -26,11 +26,16 @@
 #include <linux/kdebug.h>
 #include <linux/mutex.h>
 #include <linux/bitmap.h>
+#include <linux/cpuhotplug.h>
+#include <linux/interrupt.h>
 #include <linux/irq.h>
+#include <linux/irqdomain.h>
 #include <linux/perf_event.h>
 #include <linux/atomic.h>
 #include <linux/of.h>
+#include <asm/csr.h>
 #include <asm/perf_event.h>
+#include <asm/sbi.h>
 
 static const struct riscv_pmu *riscv_pmu __read_mostly;
 static DEFINE_PER_CPU(struct cpu_hw_events, cpu_hw_events);
@@ -459,6 +464,495 @@ static const struct riscv_pmu riscv_base_pmu = {
 	.irq = -1,
 };
 
+#ifdef CONFIG_RISCV_SBI
+/*
+ * SBI PMU extension
+ *
+ * When the firmware implements it, counters are discovered and
+ * programmed through SBI calls, and read directly from their CSRs.
+ * Counter indexes are those of the firmware. With Sscofpmf, the firmware
+ * delegates the counter overflow interrupt, which drives sampling.
+ */
+
+#define SBI_EXT_PMU				0x504D55
+#define SBI_EXT_PMU_NUM_COUNTERS		0x0
+#define SBI_EXT_PMU_COUNTER_GET_INFO		0x1
+#define SBI_EXT_PMU_COUNTER_CFG_MATCH		0x2
+#define SBI_EXT_PMU_COUNTER_START		0x3
+#define SBI_EXT_PMU_COUNTER_STOP		0x4
+
+#define SBI_PMU_CFG_FLAG_CLEAR_VALUE		(1UL << 1)
+#define SBI_PMU_CFG_FLAG_SET_UINH		(1UL << 5)
+#define SBI_PMU_CFG_FLAG_SET_SINH		(1UL << 6)
+#define SBI_PMU_START_FLAG_SET_INIT_VALUE	(1UL << 0)
+#define SBI_PMU_STOP_FLAG_RESET			(1UL << 0)
+
+#define SBI_PMU_EVENT_TYPE_CACHE		(0x1 << 16)
+#define SBI_PMU_EVENT_TYPE_RAW			(0x2 << 16)
+#define SBI_PMU_EVENT_RAW_DATA_MASK		GENMASK_ULL(47, 0)
+
+/* Counter info: CSR number in [11:0], width minus one in [17:12] */
+#define SBI_PMU_CTR_INFO_CSR(info)		((info) & 0xfff)
+#define SBI_PMU_CTR_INFO_WIDTH(info)		((((info) >> 12) & 0x3f) + 1)
+
+/* cycle, time and instret are the fixed counters */
+#define SBI_PMU_CTR_FIXED_MASK			0x7UL
+#define SBI_PMU_MAX_COUNTERS			32
+
+#define CSR_SCOUNTOVF				0xda0
+#define RV_IRQ_PMU				13
+
+struct sbi_pmu_hw_events {
+	struct perf_event *events[SBI_PMU_MAX_COUNTERS];
+	DECLARE_BITMAP(used_mask, SBI_PMU_MAX_COUNTERS);
+};
+
+static DEFINE_PER_CPU(struct sbi_pmu_hw_events, sbi_pmu_hw_events);
+static unsigned long sbi_pmu_ctr_info[SBI_PMU_MAX_COUNTERS];
+/* Counters the firmware reported, and those that can interrupt */
+static unsigned long sbi_pmu_ctr_mask;
+static unsigned long sbi_pmu_irq_ctr_mask;
+static int sbi_pmu_irq = -1;
+
+#define sbi_pmu_csr_read_case(csr)	case (csr): return csr_read(csr);
+#define sbi_pmu_csr_read_case_2(csr)	sbi_pmu_csr_read_case(csr + 0)	\
+					sbi_pmu_csr_read_case(csr + 1)
+#define sbi_pmu_csr_read_case_4(csr)	sbi_pmu_csr_read_case_2(csr + 0) \
+					sbi_pmu_csr_read_case_2(csr + 2)
+#define sbi_pmu_csr_read_case_8(csr)	sbi_pmu_csr_read_case_4(csr + 0) \
+					sbi_pmu_csr_read_case_4(csr + 4)
+#define sbi_pmu_csr_read_case_16(csr)	sbi_pmu_csr_read_case_8(csr + 0) \
+					sbi_pmu_csr_read_case_8(csr + 8)
+#define sbi_pmu_csr_read_case_32(csr)	sbi_pmu_csr_read_case_16(csr + 0) \
+					sbi_pmu_csr_read_case_16(csr + 16)
+
+/* csr_read() needs the CSR number at build time */
+static unsigned long sbi_pmu_csr_read(int csr)
+{
+	switch (csr) {
+	sbi_pmu_csr_read_case_32(CSR_CYCLE)
+#ifndef CONFIG_64BIT
+	sbi_pmu_csr_read_case_32(CSR_CYCLEH)
+#endif
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static u64 sbi_pmu_ctr_read(int idx)
+{
+	int csr = SBI_PMU_CTR_INFO_CSR(sbi_pmu_ctr_info[idx]);
+	u64 val;
+
+#ifdef CONFIG_64BIT
+	val = sbi_pmu_csr_read(csr);
+#else
+	u32 hi;
+
+	do {
+		hi = sbi_pmu_csr_read(csr + CSR_CYCLEH - CSR_CYCLE);
+		val = sbi_pmu_csr_read(csr);
+	} while (hi != sbi_pmu_csr_read(csr + CSR_CYCLEH - CSR_CYCLE));
+	val |= (u64)hi << 32;
+#endif
+
+	return val;
+}
+
+static u64 sbi_pmu_ctr_max(int idx)
+{
+	return GENMASK_ULL(SBI_PMU_CTR_INFO_WIDTH(sbi_pmu_ctr_info[idx]) - 1, 0);
+}
+
+static void sbi_pmu_ctr_start(int idx, u64 ival)
+{
+#ifdef CONFIG_64BIT
+	sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_START, idx, 1,
+		  SBI_PMU_START_FLAG_SET_INIT_VALUE, ival, 0, 0);
+#else
+	sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_START, idx, 1,
+		  SBI_PMU_START_FLAG_SET_INIT_VALUE, lower_32_bits(ival),
+		  upper_32_bits(ival), 0);
+#endif
+}
+
+static void sbi_pmu_ctr_stop(int idx, unsigned long flags)
+{
+	sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, idx, 1, flags,
+		  0, 0, 0);
+}
+
+/* SBI event indexes of the generic events, see the SBI PMU extension */
+static int sbi_pmu_event_idx(struct perf_event *event)
+{
+	u64 config = event->attr.config;
+	unsigned int type, op, result;
+
+	switch (event->attr.type) {
+	case PERF_TYPE_HARDWARE:
+		if (config >= PERF_COUNT_HW_MAX)
+			return -ENOENT;
+		return config + 1;
+	case PERF_TYPE_HW_CACHE:
+		type = config & 0xff;
+		op = (config >> 8) & 0xff;
+		result = (config >> 16) & 0xff;
+		if (type >= PERF_COUNT_HW_CACHE_MAX ||
+		    op >= PERF_COUNT_HW_CACHE_OP_MAX ||
+		    result >= PERF_COUNT_HW_CACHE_RESULT_MAX)
+			return -EINVAL;
+		return SBI_PMU_EVENT_TYPE_CACHE | (type << 3) | (op << 1) |
+		       result;
+	case PERF_TYPE_RAW:
+		return SBI_PMU_EVENT_TYPE_RAW;
+	default:
+		return -ENOENT;
+	}
+}
+
+static u64 sbi_pmu_event_update(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev_raw_count, new_raw_count, delta;
+
+	do {
+		prev_raw_count = local64_read(&hwc->prev_count);
+		new_raw_count = sbi_pmu_ctr_read(hwc->idx);
+	} while (local64_cmpxchg(&hwc->prev_count, prev_raw_count,
+				 new_raw_count) != prev_raw_count);
+
+	delta = (new_raw_count - prev_raw_count) & sbi_pmu_ctr_max(hwc->idx);
+	local64_add(delta, &event->count);
+	local64_sub(delta, &hwc->period_left);
+
+	return new_raw_count;
+}
+
+/*
+ * Returns the initial counter value that overflows at the end of the
+ * period. Counting events use half the counter range, so that a read
+ * never sees it wrap twice.
+ */
+static u64 sbi_pmu_set_period(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	s64 left = local64_read(&hwc->period_left);
+	s64 period = hwc->sample_period;
+	u64 max_period = sbi_pmu_ctr_max(hwc->idx) >> 1;
+
+	if (unlikely(left <= -period)) {
+		left = period;
+		local64_set(&hwc->period_left, left);
+		hwc->last_period = period;
+	}
+
+	if (unlikely(left <= 0)) {
+		left += period;
+		local64_set(&hwc->period_left, left);
+		hwc->last_period = period;
+	}
+
+	if (!is_sampling_event(event) || left > (s64)max_period)
+		left = max_period;
+
+	local64_set(&hwc->prev_count, (u64)-left);
+	perf_event_update_userpage(event);
+
+	return (u64)-left & sbi_pmu_ctr_max(hwc->idx);
+}
+
+static void sbi_pmu_stop(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (!(hwc->state & PERF_HES_STOPPED)) {
+		sbi_pmu_ctr_stop(hwc->idx, 0);
+		hwc->state |= PERF_HES_STOPPED;
+	}
+
+	if ((flags & PERF_EF_UPDATE) && !(hwc->state & PERF_HES_UPTODATE)) {
+		sbi_pmu_event_update(event);
+		hwc->state |= PERF_HES_UPTODATE;
+	}
+}
+
+static void sbi_pmu_start(struct perf_event *event, int flags)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (WARN_ON_ONCE(!(hwc->state & PERF_HES_STOPPED)))
+		return;
+
+	if (flags & PERF_EF_RELOAD)
+		WARN_ON_ONCE(!(hwc->state & PERF_HES_UPTODATE));
+
+	hwc->state = 0;
+
+	/*
+	 * The firmware times itself with cycle and instret, so they cannot
+	 * be given an initial value and never stop: count from where they
+	 * are. Only the programmable counters take a sampling period.
+	 */
+	if (BIT(hwc->idx) & SBI_PMU_CTR_FIXED_MASK) {
+		local64_set(&hwc->prev_count, sbi_pmu_ctr_read(hwc->idx));
+		sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_START, hwc->idx, 1,
+			  0, 0, 0, 0);
+		perf_event_update_userpage(event);
+		return;
+	}
+
+	sbi_pmu_ctr_start(hwc->idx, sbi_pmu_set_period(event));
+}
+
+static int sbi_pmu_add(struct perf_event *event, int flags)
+{
+	struct sbi_pmu_hw_events *cpuc = this_cpu_ptr(&sbi_pmu_hw_events);
+	struct hw_perf_event *hwc = &event->hw;
+	unsigned long cmask = sbi_pmu_ctr_mask & ~cpuc->used_mask[0];
+	unsigned long cflags = SBI_PMU_CFG_FLAG_CLEAR_VALUE;
+	u64 data = 0;
+	struct sbiret ret;
+
+	if (is_sampling_event(event))
+		cmask &= sbi_pmu_irq_ctr_mask;
+
+	if (event->attr.type == PERF_TYPE_RAW)
+		data = event->attr.config & SBI_PMU_EVENT_RAW_DATA_MASK;
+	if (event->attr.exclude_user)
+		cflags |= SBI_PMU_CFG_FLAG_SET_UINH;
+	if (event->attr.exclude_kernel)
+		cflags |= SBI_PMU_CFG_FLAG_SET_SINH;
+
+	/*
+	 * With Sscofpmf, found through its interrupt, only the fixed
+	 * counters keep counting in every mode.
+	 */
+	if ((cflags & ~SBI_PMU_CFG_FLAG_CLEAR_VALUE) && sbi_pmu_irq_ctr_mask)
+		cmask &= ~SBI_PMU_CTR_FIXED_MASK;
+	if (!cmask)
+		return -ENOSPC;
+
+#ifdef CONFIG_64BIT
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_CFG_MATCH, 0, cmask,
+			cflags, hwc->config, data, 0);
+#else
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_CFG_MATCH, 0, cmask,
+			cflags, hwc->config, lower_32_bits(data),
+			upper_32_bits(data));
+#endif
+	if (ret.error)
+		return ret.error == SBI_ERR_NOT_SUPPORTED ?
+		       -ENOSPC : sbi_err_map_linux_errno(ret.error);
+	if (WARN_ON_ONCE(ret.value >= SBI_PMU_MAX_COUNTERS))
+		return -EINVAL;
+
+	hwc->idx = ret.value;
+	cpuc->events[hwc->idx] = event;
+	__set_bit(hwc->idx, cpuc->used_mask);
+
+	hwc->state = PERF_HES_UPTODATE | PERF_HES_STOPPED;
+	if (flags & PERF_EF_START)
+		sbi_pmu_start(event, PERF_EF_RELOAD);
+
+	perf_event_update_userpage(event);
+
+	return 0;
+}
+
+static void sbi_pmu_del(struct perf_event *event, int flags)
+{
+	struct sbi_pmu_hw_events *cpuc = this_cpu_ptr(&sbi_pmu_hw_events);
+	struct hw_perf_event *hwc = &event->hw;
+
+	sbi_pmu_stop(event, PERF_EF_UPDATE);
+	sbi_pmu_ctr_stop(hwc->idx, SBI_PMU_STOP_FLAG_RESET);
+
+	cpuc->events[hwc->idx] = NULL;
+	__clear_bit(hwc->idx, cpuc->used_mask);
+	hwc->idx = -1;
+
+	perf_event_update_userpage(event);
+}
+
+static void sbi_pmu_read(struct perf_event *event)
+{
+	sbi_pmu_event_update(event);
+}
+
+static int sbi_pmu_event_init(struct perf_event *event)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	int code;
+
+	code = sbi_pmu_event_idx(event);
+	if (code < 0)
+		return code;
+
+	if (is_sampling_event(event) && !sbi_pmu_irq_ctr_mask)
+		return -EOPNOTSUPP;
+
+	hwc->config = code;
+	hwc->idx = -1;
+	hwc->last_period = hwc->sample_period;
+	local64_set(&hwc->period_left, hwc->sample_period);
+
+	return 0;
+}
+
+static irqreturn_t sbi_pmu_handle_irq(int irq, void *dev)
+{
+	struct sbi_pmu_hw_events *cpuc = this_cpu_ptr(&sbi_pmu_hw_events);
+	struct pt_regs *regs = get_irq_regs();
+	struct perf_sample_data data;
+	struct hw_perf_event *hwc;
+	struct perf_event *event;
+	unsigned long overflow;
+	int idx;
+
+	overflow = csr_read(CSR_SCOUNTOVF);
+	csr_clear(CSR_SIP, BIT(RV_IRQ_PMU));
+	if (!overflow)
+		return IRQ_NONE;
+
+	for_each_set_bit(idx, &overflow, SBI_PMU_MAX_COUNTERS) {
+		event = cpuc->events[idx];
+		if (!event)
+			continue;
+
+		hwc = &event->hw;
+		if (hwc->state & PERF_HES_STOPPED)
+			continue;
+
+		sbi_pmu_event_update(event);
+		perf_sample_data_init(&data, 0, hwc->last_period);
+
+		/* Restarting also clears the overflow bit of the counter */
+		if (perf_event_overflow(event, &data, regs))
+			sbi_pmu_stop(event, 0);
+		else
+			sbi_pmu_ctr_start(idx, sbi_pmu_set_period(event));
+	}
+
+	return IRQ_HANDLED;
+}
+
+static int sbi_pmu_starting_cpu(unsigned int cpu)
+{
+	enable_percpu_irq(sbi_pmu_irq, IRQ_TYPE_NONE);
+	return 0;
+}
+
+static int sbi_pmu_dying_cpu(unsigned int cpu)
+{
+	disable_percpu_irq(sbi_pmu_irq);
+	return 0;
+}
+
+/*
+ * The overflow interrupt is a local interrupt of the HART interrupt
+ * controller. Its sie bit is only writable when the firmware delegates
+ * it, which OpenSBI does with Sscofpmf only.
+ */
+static int __init sbi_pmu_irq_init(void)
+{
+	struct irq_domain *domain = NULL;
+	struct device_node *cpu, *intc;
+	int irq, ret;
+
+	csr_set(CSR_SIE, BIT(RV_IRQ_PMU));
+	ret = csr_read(CSR_SIE) & BIT(RV_IRQ_PMU);
+	csr_clear(CSR_SIE, BIT(RV_IRQ_PMU));
+	if (!ret)
+		return -EOPNOTSUPP;
+
+	for_each_of_cpu_node(cpu) {
+		intc = of_get_compatible_child(cpu, "riscv,cpu-intc");
+		if (!intc)
+			continue;
+		domain = irq_find_host(intc);
+		of_node_put(intc);
+		if (domain) {
+			of_node_put(cpu);
+			break;
+		}
+	}
+	if (!domain)
+		return -ENODEV;
+
+	irq = irq_create_mapping(domain, RV_IRQ_PMU);
+	if (!irq)
+		return -ENODEV;
+
+	ret = request_percpu_irq(irq, sbi_pmu_handle_irq, "riscv-pmu",
+				 &sbi_pmu_hw_events);
+	if (ret)
+		return ret;
+
+	sbi_pmu_irq = irq;
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "perf/riscv/sbi:online",
+				sbi_pmu_starting_cpu, sbi_pmu_dying_cpu);
+	if (ret < 0) {
+		free_percpu_irq(irq, &sbi_pmu_hw_events);
+		sbi_pmu_irq = -1;
+		return ret;
+	}
+
+	return 0;
+}
+
+static struct pmu sbi_pmu = {
+	.name		= "riscv-sbi",
+	.event_init	= sbi_pmu_event_init,
+	.add		= sbi_pmu_add,
+	.del		= sbi_pmu_del,
+	.start		= sbi_pmu_start,
+	.stop		= sbi_pmu_stop,
+	.read		= sbi_pmu_read,
+};
+
+/* Returns non-zero when the base PMU is to be used instead */
+static int __init sbi_pmu_probe(void)
+{
+	struct sbiret ret;
+	unsigned long num, idx;
+
+	if (sbi_spec_is_0_1() || sbi_probe_extension(SBI_EXT_PMU) <= 0)
+		return -EOPNOTSUPP;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_NUM_COUNTERS, 0, 0, 0, 0, 0, 0);
+	if (ret.error || !ret.value)
+		return -EOPNOTSUPP;
+	num = min_t(unsigned long, ret.value, SBI_PMU_MAX_COUNTERS);
+
+	for (idx = 0; idx < num; idx++) {
+		ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_GET_INFO, idx,
+				0, 0, 0, 0, 0);
+		if (ret.error)
+			continue;
+		sbi_pmu_ctr_info[idx] = ret.value;
+		sbi_pmu_ctr_mask |= BIT(idx);
+	}
+
+	if (!sbi_pmu_irq_init())
+		sbi_pmu_irq_ctr_mask = sbi_pmu_ctr_mask & ~SBI_PMU_CTR_FIXED_MASK;
+	else
+		sbi_pmu.capabilities |= PERF_PMU_CAP_NO_INTERRUPT;
+
+	pr_info("SBI PMU: %u counters, overflow interrupt %s\n",
+		hweight_long(sbi_pmu_ctr_mask),
+		sbi_pmu_irq_ctr_mask ? "enabled" : "not available");
+
+	return perf_pmu_register(&sbi_pmu, "cpu", PERF_TYPE_RAW);
+}
+#else
+static int __init sbi_pmu_probe(void)
+{
+	return -ENODEV;
+}
+#endif
+
 static const struct of_device_id riscv_pmu_of_ids[] = {
 	{.compatible = "riscv,base-pmu",	.data = &riscv_base_pmu},
 	{ /* sentinel value */ }
@@ -466,11 +960,15 @@ static const struct of_device_id riscv_pmu_of_ids[] = {
 
 static int __init init_hw_perf_events(void)
 {
-	struct device_node *node = of_find_node_by_type(NULL, "pmu");
+	struct device_node *node;
 	const struct of_device_id *of_id;
 
+	if (!sbi_pmu_probe())
+		return 0;
+
 	riscv_pmu = &riscv_base_pmu;
 
+	node = of_find_node_by_type(NULL, "pmu");
 	if (node) {
 		of_id = of_match_node(riscv_pmu_of_ids, node);
 
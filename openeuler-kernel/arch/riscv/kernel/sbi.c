@@ -5,15 +5,39 @@
  * Copyright (c) 2020 Western Digital Corporation or its affiliates.
  */
 
+#include <linux/cpuhotplug.h>
 #include <linux/init.h>
+#include <linux/mm.h>
 #include <linux/pm.h>
 #include <asm/sbi.h>
 #include <asm/smp.h>
 
+/* OpenSBI specific asynchronous completion mode of the RFENCE extension */
+#define SBI_EXT_RFENCE_ASYNC_FLAG	0x100
+#define SBI_EXT_RFENCE_TICKET_POLL	0x200
+#define SBI_EXT_RFENCE_TICKET_WAIT	0x201
+
+/* OpenSBI specific hart_mask_base: hart_mask is the address of a bitmap */
+#define SBI_HART_MASK_BASE_SHMEM	-2UL
+
+/* SBI debug console extension */
+#define SBI_EXT_DBCN			0x4442434E
+#define SBI_EXT_DBCN_CONSOLE_WRITE	0x0
+
 /* default SBI version is 0.1 */
 unsigned long sbi_spec_version = SBI_SPEC_VERSION_DEFAULT;
 EXPORT_SYMBOL(sbi_spec_version);
 
+static bool sbi_rfence_async;
+
+/*
+ * With hart masks passed by address, every IPI or remote fence is a
+ * single ecall. Broadcasts use the hart IDs of the CPUs that are up,
+ * which the hotplug callbacks below keep current.
+ */
+static bool sbi_hart_mask_shmem;
+static struct cpumask sbi_online_hart_mask;
+
 static void (*__sbi_set_timer)(uint64_t stime);
 static int (*__sbi_send_ipi)(const unsigned long *hart_mask);
 static int (*__sbi_rfence)(int fid, const unsigned long *hart_mask,
@@ -211,6 +235,32 @@ static void __sbi_set_timer_v02(uint64_t stime_value)
 #endif
 }
 
+static const unsigned long *sbi_hart_mask_or_online(const unsigned long *hart_mask)
+{
+	if (!hart_mask || bitmap_empty(hart_mask, NR_CPUS))
+		return cpumask_bits(&sbi_online_hart_mask);
+
+	return hart_mask;
+}
+
+static int __sbi_send_ipi_shmem(const unsigned long *hart_mask)
+{
+	struct sbiret ret;
+	int result;
+
+	hart_mask = sbi_hart_mask_or_online(hart_mask);
+	ret = sbi_ecall(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI,
+			(unsigned long)hart_mask, SBI_HART_MASK_BASE_SHMEM,
+			0, 0, 0, 0);
+	if (!ret.error)
+		return 0;
+
+	result = sbi_err_map_linux_errno(ret.error);
+	pr_err("%s: hmask = [%*pb] failed (error [%d])\n",
+	       __func__, NR_CPUS, hart_mask, result);
+	return result;
+}
+
 static int __sbi_send_ipi_v02(const unsigned long *hart_mask)
 {
 	unsigned long hartid, hmask_val, hbase;
@@ -218,6 +268,9 @@ static int __sbi_send_ipi_v02(const unsigned long *hart_mask)
 	struct sbiret ret = {0};
 	int result;
 
+	if (sbi_hart_mask_shmem)
+		return __sbi_send_ipi_shmem(hart_mask);
+
 	if (!hart_mask || !(*hart_mask)) {
 		riscv_cpuid_to_hartid_mask(cpu_online_mask, &tmask);
 		hart_mask = cpumask_bits(&tmask);
@@ -264,7 +317,7 @@ static int __sbi_rfence_v02_call(unsigned long fid, unsigned long hmask_val,
 	int ext = SBI_EXT_RFENCE;
 	int result = 0;
 
-	switch (fid) {
+	switch (fid & ~SBI_EXT_RFENCE_ASYNC_FLAG) {
 	case SBI_EXT_RFENCE_REMOTE_FENCE_I:
 		ret = sbi_ecall(ext, fid, hmask_val, hbase, 0, 0, 0, 0);
 		break;
@@ -303,6 +356,8 @@ static int __sbi_rfence_v02_call(unsigned long fid, unsigned long hmask_val,
 		result = sbi_err_map_linux_errno(ret.error);
 		pr_err("%s: hbase = [%lu] hmask = [0x%lx] failed (error [%d])\n",
 		       __func__, hbase, hmask_val, result);
+	} else if ((fid & SBI_EXT_RFENCE_ASYNC_FLAG) && arg5) {
+		*(unsigned long *)arg5 = ret.value;
 	}
 
 	return result;
@@ -316,6 +371,13 @@ static int __sbi_rfence_v02(int fid, const unsigned long *hart_mask,
 	struct cpumask tmask;
 	int result;
 
+	if (sbi_hart_mask_shmem) {
+		hart_mask = sbi_hart_mask_or_online(hart_mask);
+		return __sbi_rfence_v02_call(fid, (unsigned long)hart_mask,
+					     SBI_HART_MASK_BASE_SHMEM, start,
+					     size, arg4, arg5);
+	}
+
 	if (!hart_mask || !(*hart_mask)) {
 		riscv_cpuid_to_hartid_mask(cpu_online_mask, &tmask);
 		hart_mask = cpumask_bits(&tmask);
@@ -501,6 +563,189 @@ int sbi_remote_hfence_vvma_asid(const unsigned long *hart_mask,
 }
 EXPORT_SYMBOL(sbi_remote_hfence_vvma_asid);
 
+static int __sbi_rfence_async(int fid, const unsigned long *hart_mask,
+			      unsigned long start, unsigned long size,
+			      unsigned long arg4, unsigned long *ticket)
+{
+	int result;
+
+	/*
+	 * A ticket covers a single ecall, so requests that need one ecall
+	 * per window of harts are sent synchronously.
+	 */
+	*ticket = 0;
+	if (!sbi_rfence_async || !sbi_hart_mask_shmem)
+		return __sbi_rfence(fid, hart_mask, start, size, arg4, 0);
+
+	return __sbi_rfence(fid | SBI_EXT_RFENCE_ASYNC_FLAG, hart_mask,
+			    start, size, arg4, (unsigned long)ticket);
+}
+
+/**
+ * sbi_remote_fence_i_async() - Queue FENCE.I on given remote harts without
+ *				waiting for them to execute it.
+ * @hart_mask: A cpu mask containing all the target harts.
+ * @ticket: Completion ticket to pass to sbi_rfence_ticket_wait().
+ *
+ * Return: 0 if success, Error otherwise.
+ */
+int sbi_remote_fence_i_async(const unsigned long *hart_mask,
+			     unsigned long *ticket)
+{
+	return __sbi_rfence_async(SBI_EXT_RFENCE_REMOTE_FENCE_I,
+				  hart_mask, 0, 0, 0, ticket);
+}
+EXPORT_SYMBOL(sbi_remote_fence_i_async);
+
+/**
+ * sbi_remote_sfence_vma_async() - Queue SFENCE.VMA on given remote harts
+ *				   without waiting for them to execute it.
+ * @hart_mask: A cpu mask containing all the target harts.
+ * @start: Start of the virtual address
+ * @size: Total size of the virtual address range.
+ * @ticket: Completion ticket to pass to sbi_rfence_ticket_wait().
+ *
+ * Return: 0 if success, Error otherwise.
+ */
+int sbi_remote_sfence_vma_async(const unsigned long *hart_mask,
+				unsigned long start,
+				unsigned long size,
+				unsigned long *ticket)
+{
+	return __sbi_rfence_async(SBI_EXT_RFENCE_REMOTE_SFENCE_VMA,
+				  hart_mask, start, size, 0, ticket);
+}
+EXPORT_SYMBOL(sbi_remote_sfence_vma_async);
+
+/**
+ * sbi_remote_sfence_vma_asid_async() - Queue SFENCE.VMA on given remote harts
+ * for a virtual address range belonging to a specific ASID without waiting
+ * for them to execute it.
+ *
+ * @hart_mask: A cpu mask containing all the target harts.
+ * @start: Start of the virtual address
+ * @size: Total size of the virtual address range.
+ * @asid: The value of address space identifier (ASID).
+ * @ticket: Completion ticket to pass to sbi_rfence_ticket_wait().
+ *
+ * Return: 0 if success, Error otherwise.
+ */
+int sbi_remote_sfence_vma_asid_async(const unsigned long *hart_mask,
+				     unsigned long start,
+				     unsigned long size,
+				     unsigned long asid,
+				     unsigned long *ticket)
+{
+	return __sbi_rfence_async(SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID,
+				  hart_mask, start, size, asid, ticket);
+}
+EXPORT_SYMBOL(sbi_remote_sfence_vma_asid_async);
+
+static int __sbi_rfence_ticket(int fid, unsigned long ticket)
+{
+	struct sbiret ret;
+
+	if (!sbi_rfence_async || !ticket)
+		return 1;
+
+	ret = sbi_ecall(SBI_EXT_RFENCE, fid, ticket, 0, 0, 0, 0, 0);
+	if (ret.error)
+		return sbi_err_map_linux_errno(ret.error);
+
+	return !!ret.value;
+}
+
+/**
+ * sbi_rfence_ticket_done() - Check whether an asynchronous remote fence
+ *			      has been executed by all its target harts.
+ * @ticket: Ticket returned by one of the sbi_remote_*_async() calls.
+ *
+ * A ticket only covers the request it was returned for, every ticket of
+ * a batch has to be checked.
+ *
+ * Return: 1 if complete, 0 if still pending, Error otherwise.
+ */
+int sbi_rfence_ticket_done(unsigned long ticket)
+{
+	return __sbi_rfence_ticket(SBI_EXT_RFENCE_TICKET_POLL, ticket);
+}
+EXPORT_SYMBOL(sbi_rfence_ticket_done);
+
+/**
+ * sbi_rfence_ticket_wait() - Wait for an asynchronous remote fence to be
+ *			      executed by all its target harts.
+ * @ticket: Ticket returned by one of the sbi_remote_*_async() calls.
+ *
+ * The firmware waits inside the call, serving the fences queued to this
+ * hart meanwhile, but bounds each call. It is repeated until the ticket
+ * completes.
+ *
+ * Return: 0 if success, Error otherwise.
+ */
+int sbi_rfence_ticket_wait(unsigned long ticket)
+{
+	int ret;
+
+	while (!(ret = __sbi_rfence_ticket(SBI_EXT_RFENCE_TICKET_WAIT,
+					   ticket)))
+		cpu_relax();
+
+	return ret < 0 ? ret : 0;
+}
+EXPORT_SYMBOL(sbi_rfence_ticket_wait);
+
+/**
+ * sbi_debug_console_write() - Write a string to the console device.
+ * @bytes: The string to be written, in the linear map or vmalloc space.
+ * @num_bytes: Length of the string.
+ *
+ * The whole string is handed to the firmware in one call, up to the end
+ * of the page it starts in. The firmware may take fewer bytes when its
+ * buffer is full.
+ *
+ * Return: number of bytes written, or a negative errno on failure.
+ */
+int sbi_debug_console_write(const char *bytes, unsigned int num_bytes)
+{
+	phys_addr_t base_addr;
+	struct sbiret ret;
+
+	if (is_vmalloc_addr(bytes))
+		base_addr = page_to_phys(vmalloc_to_page(bytes)) +
+			    offset_in_page(bytes);
+	else
+		base_addr = __pa(bytes);
+	if (PAGE_SIZE < offset_in_page(bytes) + num_bytes)
+		num_bytes = PAGE_SIZE - offset_in_page(bytes);
+
+	if (IS_ENABLED(CONFIG_32BIT))
+		ret = sbi_ecall(SBI_EXT_DBCN, SBI_EXT_DBCN_CONSOLE_WRITE,
+				num_bytes, lower_32_bits(base_addr),
+				upper_32_bits(base_addr), 0, 0, 0);
+	else
+		ret = sbi_ecall(SBI_EXT_DBCN, SBI_EXT_DBCN_CONSOLE_WRITE,
+				num_bytes, base_addr, 0, 0, 0, 0);
+
+	if (ret.error)
+		return sbi_err_map_linux_errno(ret.error);
+
+	return ret.value;
+}
+EXPORT_SYMBOL(sbi_debug_console_write);
+
+/**
+ * sbi_debug_console_available() - Check for the SBI debug console extension.
+ *
+ * Usable before sbi_init(), for early consoles.
+ *
+ * Return: true if the extension is implemented, false otherwise.
+ */
+bool sbi_debug_console_available(void)
+{
+	return sbi_probe_extension(SBI_EXT_DBCN) > 0;
+}
+EXPORT_SYMBOL(sbi_debug_console_available);
+
 /**
  * sbi_probe_extension() - Check if an SBI extension ID is supported or not.
  * @extid: The extension ID to be probed.
@@ -560,6 +805,54 @@ static struct riscv_ipi_ops sbi_ipi_ops = {
 	.ipi_inject = sbi_send_cpumask_ipi
 };
 
+static int sbi_hart_mask_starting(unsigned int cpu)
+{
+	cpumask_set_cpu(cpuid_to_hartid_map(cpu), &sbi_online_hart_mask);
+	return 0;
+}
+
+static int sbi_hart_mask_dying(unsigned int cpu)
+{
+	cpumask_clear_cpu(cpuid_to_hartid_map(cpu), &sbi_online_hart_mask);
+	return 0;
+}
+
+/*
+ * Switch to hart masks passed by address if the firmware takes them:
+ * older ones reject the hart_mask_base, newer ones accept the empty mask
+ * as a no-op. Runs before SMP bring-up, and the starting and dying
+ * callbacks run on the CPU itself, so the mask covers every CPU that is
+ * up, while it is up.
+ */
+static int __init sbi_hart_mask_init(void)
+{
+	static const struct cpumask empty __initconst;
+	struct sbiret ret;
+	int err;
+
+	if (sbi_spec_is_0_1() || sbi_probe_extension(SBI_EXT_IPI) <= 0 ||
+	    sbi_probe_extension(SBI_EXT_RFENCE) <= 0)
+		return 0;
+
+	ret = sbi_ecall(SBI_EXT_IPI, SBI_EXT_IPI_SEND_IPI,
+			(unsigned long)cpumask_bits(&empty),
+			SBI_HART_MASK_BASE_SHMEM, 0, 0, 0, 0);
+	if (ret.error)
+		return 0;
+
+	err = cpuhp_setup_state(CPUHP_AP_RISCV_SBI_STARTING,
+				"riscv/sbi:starting", sbi_hart_mask_starting,
+				sbi_hart_mask_dying);
+	if (err)
+		return err;
+
+	sbi_hart_mask_shmem = true;
+	pr_info("SBI hart masks passed by address\n");
+
+	return 0;
+}
+early_initcall(sbi_hart_mask_init);
+
 int __init sbi_init(void)
 {
 	int ret;
@@ -590,6 +883,11 @@ int __init sbi_init(void)
 		if (sbi_probe_extension(SBI_EXT_RFENCE) > 0) {
 			__sbi_rfence	= __sbi_rfence_v02;
 			pr_info("SBI v0.2 RFENCE extension detected\n");
+			sbi_rfence_async = !sbi_ecall(SBI_EXT_RFENCE,
+					SBI_EXT_RFENCE_TICKET_POLL,
+					0, 0, 0, 0, 0, 0).error;
+			if (sbi_rfence_async)
+				pr_info("SBI RFENCE async completion detected\n");
 		} else {
 			__sbi_rfence	= __sbi_rfence_v01;
 		}
@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Drain the per-hart OpenSBI trace buffers into the ftrace ring buffer.
+ *
+ * Each CPU hands its firmware a buffer of its own, which the firmware
+ * fills with records of ecalls, traps, IPIs, TLB flushes and enclave
+ * switches. The kernel only reads the buffers, through a read-only
+ * mapping, and turns the records into sbi_mmode trace events.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpuhotplug.h>
+#include <linux/debugfs.h>
+#include <linux/gfp.h>
+#include <linux/init.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <asm/sbi.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/sbi.h>
+
+/* OpenSBI specific PROFILE extension */
+#define SBI_EXT_PROFILE			0x08000000
+#define SBI_EXT_PROFILE_TRACE_START	0x9
+#define SBI_EXT_PROFILE_TRACE_STOP	0xa
+
+#define SBI_TRACE_ORDER			2
+#define SBI_TRACE_PAGES			(1 << SBI_TRACE_ORDER)
+#define SBI_TRACE_SIZE			(PAGE_SIZE << SBI_TRACE_ORDER)
+
+/* Buffer layout shared with the firmware */
+struct sbi_trace_record {
+	u64 time;
+	u32 event;
+	u32 info;
+	u64 arg0;
+	u64 arg1;
+};
+
+struct sbi_trace_ring {
+	u64 head;
+	u64 entries;
+	u64 reserved[2];
+	struct sbi_trace_record records[];
+};
+
+struct sbi_trace_cpu {
+	struct page *pages;
+	const struct sbi_trace_ring *ring;
+	u64 entries;
+	u64 tail;
+	bool active;
+};
+
+static DEFINE_PER_CPU(struct sbi_trace_cpu, sbi_trace_cpus);
+static DEFINE_MUTEX(sbi_trace_lock);
+static DEFINE_MUTEX(sbi_trace_drain_lock);
+static u64 sbi_trace_events;
+static u32 sbi_trace_period_ms = 10;
+static u64 sbi_trace_lost;
+
+static void sbi_trace_drain(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sbi_trace_work, sbi_trace_drain);
+
+static int sbi_trace_alloc(int cpu, struct sbi_trace_cpu *tc)
+{
+	struct page *pages[SBI_TRACE_PAGES];
+	int i;
+
+	if (tc->pages)
+		return 0;
+
+	tc->pages = alloc_pages_node(cpu_to_node(cpu), GFP_KERNEL | __GFP_ZERO,
+				     SBI_TRACE_ORDER);
+	if (!tc->pages)
+		return -ENOMEM;
+
+	for (i = 0; i < SBI_TRACE_PAGES; i++)
+		pages[i] = tc->pages + i;
+	tc->ring = vmap(pages, SBI_TRACE_PAGES, VM_MAP, PAGE_KERNEL_RO);
+	if (!tc->ring) {
+		__free_pages(tc->pages, SBI_TRACE_ORDER);
+		tc->pages = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void sbi_trace_free(struct sbi_trace_cpu *tc)
+{
+	if (!tc->pages)
+		return;
+
+	vunmap(tc->ring);
+	__free_pages(tc->pages, SBI_TRACE_ORDER);
+	tc->ring = NULL;
+	tc->pages = NULL;
+}
+
+/* Must run on the CPU whose buffer is started */
+static void sbi_trace_start_cpu(void *info)
+{
+	struct sbi_trace_cpu *tc = this_cpu_ptr(&sbi_trace_cpus);
+	struct sbiret ret;
+	u64 entries;
+
+	ret = sbi_ecall(SBI_EXT_PROFILE, SBI_EXT_PROFILE_TRACE_START,
+			page_to_phys(tc->pages), SBI_TRACE_SIZE,
+			sbi_trace_events, 0, 0, 0);
+	if (ret.error)
+		return;
+
+	entries = READ_ONCE(tc->ring->entries);
+	if (!entries || (entries & (entries - 1)) ||
+	    entries > (SBI_TRACE_SIZE - sizeof(*tc->ring)) /
+		      sizeof(struct sbi_trace_record)) {
+		sbi_ecall(SBI_EXT_PROFILE, SBI_EXT_PROFILE_TRACE_STOP,
+			  0, 0, 0, 0, 0, 0);
+		return;
+	}
+
+	tc->entries = entries;
+	tc->tail = 0;
+	tc->active = true;
+}
+
+/* Must run on the CPU whose buffer is stopped */
+static void sbi_trace_stop_cpu(void *info)
+{
+	struct sbi_trace_cpu *tc = this_cpu_ptr(&sbi_trace_cpus);
+
+	sbi_ecall(SBI_EXT_PROFILE, SBI_EXT_PROFILE_TRACE_STOP,
+		  0, 0, 0, 0, 0, 0);
+	tc->active = false;
+}
+
+static void sbi_trace_drain_cpu(int cpu, struct sbi_trace_cpu *tc)
+{
+	const struct sbi_trace_record *rec;
+	struct sbi_trace_record r;
+	u64 head;
+
+	head = READ_ONCE(tc->ring->head);
+	smp_rmb();
+
+	if (head - tc->tail > tc->entries) {
+		sbi_trace_lost += head - tc->tail - tc->entries;
+		tc->tail = head - tc->entries;
+	}
+
+	for (; tc->tail != head; tc->tail++) {
+		rec = &tc->ring->records[tc->tail & (tc->entries - 1)];
+		r = *rec;
+		smp_rmb();
+
+		/* The firmware may have wrapped over the record meanwhile */
+		if (READ_ONCE(tc->ring->head) - tc->tail > tc->entries) {
+			sbi_trace_lost++;
+			continue;
+		}
+
+		trace_sbi_mmode(cpu, r.time, r.event, r.info, r.arg0, r.arg1);
+	}
+}
+
+static void sbi_trace_drain(struct work_struct *work)
+{
+	struct sbi_trace_cpu *tc;
+	int cpu;
+
+	mutex_lock(&sbi_trace_drain_lock);
+	for_each_possible_cpu(cpu) {
+		tc = per_cpu_ptr(&sbi_trace_cpus, cpu);
+		if (tc->active)
+			sbi_trace_drain_cpu(cpu, tc);
+	}
+	mutex_unlock(&sbi_trace_drain_lock);
+
+	schedule_delayed_work(&sbi_trace_work,
+			      msecs_to_jiffies(sbi_trace_period_ms));
+}
+
+static int sbi_trace_cpu_online(unsigned int cpu)
+{
+	struct sbi_trace_cpu *tc = per_cpu_ptr(&sbi_trace_cpus, cpu);
+
+	if (!sbi_trace_events || sbi_trace_alloc(cpu, tc))
+		return 0;
+
+	sbi_trace_start_cpu(NULL);
+
+	return 0;
+}
+
+static int sbi_trace_cpu_offline(unsigned int cpu)
+{
+	struct sbi_trace_cpu *tc = per_cpu_ptr(&sbi_trace_cpus, cpu);
+
+	if (!tc->active)
+		return 0;
+
+	sbi_trace_stop_cpu(NULL);
+	mutex_lock(&sbi_trace_drain_lock);
+	sbi_trace_drain_cpu(cpu, tc);
+	mutex_unlock(&sbi_trace_drain_lock);
+
+	return 0;
+}
+
+static void sbi_trace_disable(void)
+{
+	struct sbi_trace_cpu *tc;
+	int cpu;
+
+	cancel_delayed_work_sync(&sbi_trace_work);
+
+	for_each_possible_cpu(cpu) {
+		tc = per_cpu_ptr(&sbi_trace_cpus, cpu);
+		if (tc->active) {
+			smp_call_function_single(cpu, sbi_trace_stop_cpu,
+						 NULL, 1);
+			sbi_trace_drain_cpu(cpu, tc);
+		}
+		sbi_trace_free(tc);
+	}
+}
+
+static int sbi_trace_enable(void)
+{
+	struct sbi_trace_cpu *tc;
+	bool started = false;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		tc = per_cpu_ptr(&sbi_trace_cpus, cpu);
+		if (sbi_trace_alloc(cpu, tc))
+			continue;
+		smp_call_function_single(cpu, sbi_trace_start_cpu, NULL, 1);
+		started |= tc->active;
+	}
+
+	if (!started) {
+		sbi_trace_disable();
+		return -EOPNOTSUPP;
+	}
+
+	schedule_delayed_work(&sbi_trace_work,
+			      msecs_to_jiffies(sbi_trace_period_ms));
+
+	return 0;
+}
+
+static int sbi_trace_events_get(void *data, u64 *val)
+{
+	*val = sbi_trace_events;
+
+	return 0;
+}
+
+static int sbi_trace_events_set(void *data, u64 val)
+{
+	int ret = 0;
+
+	mutex_lock(&sbi_trace_lock);
+	cpus_read_lock();
+
+	if (sbi_trace_events)
+		sbi_trace_disable();
+	sbi_trace_events = val;
+	if (sbi_trace_events) {
+		ret = sbi_trace_enable();
+		if (ret)
+			sbi_trace_events = 0;
+	}
+
+	cpus_read_unlock();
+	mutex_unlock(&sbi_trace_lock);
+
+	return ret;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(sbi_trace_events_fops, sbi_trace_events_get,
+			 sbi_trace_events_set, "0x%llx\n");
+
+static int __init sbi_trace_init(void)
+{
+	struct dentry *dir;
+	int ret;
+
+	if (sbi_probe_extension(SBI_EXT_PROFILE) <= 0)
+		return 0;
+
+	ret = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN,
+					"riscv/sbi_trace:online",
+					sbi_trace_cpu_online,
+					sbi_trace_cpu_offline);
+	if (ret < 0)
+		return ret;
+
+	dir = debugfs_create_dir("sbi_trace", NULL);
+	debugfs_create_file_unsafe("events", 0600, dir, NULL,
+				   &sbi_trace_events_fops);
+	debugfs_create_u32("period_ms", 0600, dir, &sbi_trace_period_ms);
+	debugfs_create_u64("lost", 0400, dir, &sbi_trace_lost);
+
+	return 0;
+}
+late_initcall(sbi_trace_init);
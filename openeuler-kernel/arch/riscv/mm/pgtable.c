@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Transparent huge page support for Sv39 and Sv48
+ *
+ * A huge PMD is a leaf entry at the PMD level, laid out exactly like a
+ * PTE, so the PMD operations are the PTE ones applied to the PMD slot.
+ */
+
+#include <linux/mm.h>
+#include <linux/pgtable.h>
+#include <asm/tlbflush.h>
+
+void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+		pmd_t *pmdp, pmd_t pmd)
+{
+	set_pte_at(mm, addr, (pte_t *)pmdp, pmd_pte(pmd));
+}
+
+int pmdp_set_access_flags(struct vm_area_struct *vma, unsigned long address,
+			  pmd_t *pmdp, pmd_t entry, int dirty)
+{
+	return ptep_set_access_flags(vma, address, (pte_t *)pmdp,
+				     pmd_pte(entry), dirty);
+}
+
+int pmdp_test_and_clear_young(struct vm_area_struct *vma,
+			      unsigned long address, pmd_t *pmdp)
+{
+	return ptep_test_and_clear_young(vma, address, (pte_t *)pmdp);
+}
+
+pmd_t pmdp_huge_get_and_clear(struct mm_struct *mm, unsigned long address,
+			      pmd_t *pmdp)
+{
+	return pte_pmd(ptep_get_and_clear(mm, address, (pte_t *)pmdp));
+}
+
+void pmdp_set_wrprotect(struct mm_struct *mm, unsigned long address,
+			pmd_t *pmdp)
+{
+	ptep_set_wrprotect(mm, address, (pte_t *)pmdp);
+}
+
+pmd_t pmdp_establish(struct vm_area_struct *vma, unsigned long address,
+		     pmd_t *pmdp, pmd_t pmd)
+{
+	return __pmd(atomic_long_xchg((atomic_long_t *)pmdp, pmd_val(pmd)));
+}
+
+/*
+ * Collapsing turns the pointer to a PTE table into a leaf. sfence.vma
+ * with an address only orders leaf entries, so the non-leaf entry may
+ * stay cached and only a full flush of the mm gets rid of it.
+ */
+pmd_t pmdp_collapse_flush(struct vm_area_struct *vma, unsigned long address,
+			  pmd_t *pmdp)
+{
+	pmd_t pmd = pmdp_huge_get_and_clear(vma->vm_mm, address, pmdp);
+
+	VM_BUG_ON(address & ~HPAGE_PMD_MASK);
+	VM_BUG_ON(pmd_trans_huge(*pmdp));
+	flush_tlb_mm(vma->vm_mm);
+
+	return pmd;
+}
+
+void update_mmu_cache_pmd(struct vm_area_struct *vma, unsigned long address,
+			  pmd_t *pmdp)
+{
+	update_mmu_cache(vma, address, (pte_t *)pmdp);
+}
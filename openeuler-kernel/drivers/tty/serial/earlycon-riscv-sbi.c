@@ -22,10 +22,27 @@ static void sbi_console_write(struct console *con,
 	uart_console_write(&dev->port, s, n, sbi_putc);
 }
 
+static void sbi_dbcn_console_write(struct console *con,
+				   const char *s, unsigned n)
+{
+	int ret;
+
+	while (n) {
+		ret = sbi_debug_console_write(s, n);
+		if (ret <= 0)
+			break;
+		s += ret;
+		n -= ret;
+	}
+}
+
 static int __init early_sbi_setup(struct earlycon_device *device,
 				  const char *opt)
 {
-	device->con->write = sbi_console_write;
+	if (sbi_debug_console_available())
+		device->con->write = sbi_dbcn_console_write;
+	else
+		device->con->write = sbi_console_write;
 	return 0;
 }
 EARLYCON_DECLARE(sbi, early_sbi_setup);
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sbi
+
+#if !defined(_TRACE_SBI_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_SBI_H
+
+#include <linux/tracepoint.h>
+
+#define show_sbi_mmode_event(event)				\
+	__print_symbolic(event,					\
+		{ 0,	"ecall_enter" },			\
+		{ 1,	"ecall_exit" },				\
+		{ 2,	"trap" },				\
+		{ 3,	"ipi" },				\
+		{ 4,	"tlb_flush" },				\
+		{ 5,	"enclave" })
+
+/**
+ * sbi_mmode - a record drained from the M-mode firmware trace buffer
+ *
+ * @cpu: CPU whose firmware wrote the record
+ * @time: timer value when the record was written, same base as rdtime
+ * @event: firmware trace event
+ * @info: event specific small value
+ * @arg0: event specific argument
+ * @arg1: event specific argument
+ */
+TRACE_EVENT(sbi_mmode,
+
+	TP_PROTO(int cpu, u64 time, u32 event, u32 info, u64 arg0, u64 arg1),
+
+	TP_ARGS(cpu, time, event, info, arg0, arg1),
+
+	TP_STRUCT__entry(
+		__field(int, cpu)
+		__field(u64, time)
+		__field(u32, event)
+		__field(u32, info)
+		__field(u64, arg0)
+		__field(u64, arg1)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->time = time;
+		__entry->event = event;
+		__entry->info = info;
+		__entry->arg0 = arg0;
+		__entry->arg1 = arg1;
+	),
+
+	TP_printk("cpu=%d time=%llu %s info=%u arg0=0x%llx arg1=0x%llx",
+		  __entry->cpu, __entry->time,
+		  show_sbi_mmode_event(__entry->event), __entry->info,
+		  __entry->arg0, __entry->arg1)
+);
+
+#endif /*  _TRACE_SBI_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
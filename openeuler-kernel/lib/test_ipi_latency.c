@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * test_ipi_latency.c: Time IPI round trips between CPUs
+ *
+ * Each round trip is a synchronous smp_call_function_single() with an
+ * empty callback: one IPI out, and the target acknowledging through
+ * the csd lock, which the sender spins on.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpu.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/smp.h>
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Round trips per target CPU (default: 10000)");
+
+static int target = -1;
+module_param(target, int, 0444);
+MODULE_PARM_DESC(target, "Only time this CPU (default: every online CPU)");
+
+static void ipi_latency_nop(void *info)
+{
+}
+
+static int ipi_latency_run(int cpu)
+{
+	u64 t, min = U64_MAX, max = 0, total = 0;
+	unsigned int i;
+	int self, ret = 0;
+
+	/* A call to the current CPU would not send an IPI at all */
+	self = get_cpu();
+	if (cpu == self)
+		goto out;
+
+	for (i = 0; i < iterations; i++) {
+		t = ktime_get_ns();
+		ret = smp_call_function_single(cpu, ipi_latency_nop, NULL, 1);
+		t = ktime_get_ns() - t;
+		if (ret)
+			goto out;
+
+		total += t;
+		min = min(min, t);
+		max = max(max, t);
+	}
+
+	pr_info("cpu%d -> cpu%d: min %llu ns, avg %llu ns, max %llu ns\n",
+		self, cpu, min, div_u64(total, iterations), max);
+out:
+	put_cpu();
+	return ret;
+}
+
+static int __init test_ipi_latency_init(void)
+{
+	int cpu, ret = 0;
+
+	if (!iterations)
+		return -EINVAL;
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		if (target >= 0 && cpu != target)
+			continue;
+
+		ret = ipi_latency_run(cpu);
+		if (ret)
+			break;
+	}
+	cpus_read_unlock();
+
+	return ret;
+}
+
+static void __exit test_ipi_latency_exit(void)
+{
+}
+
+module_init(test_ipi_latency_init);
+module_exit(test_ipi_latency_exit);
+MODULE_DESCRIPTION("IPI round-trip latency benchmark");
+MODULE_LICENSE("GPL");
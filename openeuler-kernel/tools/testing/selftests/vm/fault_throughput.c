@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Anonymous page fault throughput, with or without transparent huge pages
+ *
+ * Maps a fresh anonymous region on every pass and writes one byte per
+ * base page, so that each pass pays for every fault. The region always
+ * starts on a PMD boundary, so that runs only differ in the advice: -H
+ * madvises it MADV_HUGEPAGE, -N madvises it MADV_NOHUGEPAGE. The share
+ * of the region backed by huge pages is read back from
+ * /proc/self/smaps_rollup.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MB			(1UL << 20)
+#define PMD_SIZE_DEFAULT	(2 * MB)
+
+static unsigned long anon_huge_kb(void)
+{
+	unsigned long kb = 0;
+	char line[256];
+	FILE *f;
+
+	f = fopen("/proc/self/smaps_rollup", "r");
+	if (!f)
+		return 0;
+
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+			break;
+	fclose(f);
+
+	return kb;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s size_mb] [-n passes] [-H | -N]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long size = 256 * MB, page = sysconf(_SC_PAGESIZE);
+	unsigned long i, off, huge_kb;
+	int opt, pass, passes = 5, advice = -1;
+	double start, elapsed, total = 0;
+	char *map, *buf;
+
+	while ((opt = getopt(argc, argv, "s:n:HN")) != -1) {
+		switch (opt) {
+		case 's':
+			size = strtoul(optarg, NULL, 0) * MB;
+			break;
+		case 'n':
+			passes = atoi(optarg);
+			break;
+		case 'H':
+			advice = MADV_HUGEPAGE;
+			break;
+		case 'N':
+			advice = MADV_NOHUGEPAGE;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!size || passes <= 0)
+		usage(argv[0]);
+
+	for (pass = 0; pass < passes; pass++) {
+		/* Over-map so that the region can start on a PMD boundary */
+		map = mmap(NULL, size + PMD_SIZE_DEFAULT, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		off = -(unsigned long)map & (PMD_SIZE_DEFAULT - 1);
+		buf = map + off;
+
+		if (advice >= 0 && madvise(buf, size, advice)) {
+			perror("madvise");
+			return 1;
+		}
+
+		start = now();
+		for (i = 0; i < size; i += page)
+			buf[i] = 1;
+		elapsed = now() - start;
+		total += elapsed;
+
+		huge_kb = anon_huge_kb();
+		printf("pass %d: %.3f s, %.0f pages/s, %.1f MiB/s, %lu%% huge\n",
+		       pass, elapsed, size / page / elapsed,
+		       size / MB / elapsed, huge_kb * 1024 * 100 / size);
+
+		munmap(map, size + PMD_SIZE_DEFAULT);
+	}
+
+	printf("average: %.1f MiB/s over %d passes of %lu MiB\n",
+	       size / MB * passes / total, passes, size / MB);
+
+	return 0;
+}
@@ -76,6 +76,7 @@
 #define IRQ_VS_EXT			10
 #define IRQ_M_EXT			11
 #define IRQ_S_GEXT			12
+#define IRQ_PMU_OVF			13
 
 #define MIP_SSIP			(_UL(1) << IRQ_S_SOFT)
 #define MIP_VSSIP			(_UL(1) << IRQ_VS_SOFT)
@@ -87,6 +88,7 @@
 #define MIP_VSEIP			(_UL(1) << IRQ_VS_EXT)
 #define MIP_MEIP			(_UL(1) << IRQ_M_EXT)
 #define MIP_SGEIP			(_UL(1) << IRQ_S_GEXT)
+#define MIP_LCOFIP			(_UL(1) << IRQ_PMU_OVF)
 
 #define SIP_SSIP			MIP_SSIP
 #define SIP_STIP			MIP_STIP
@@ -303,6 +305,7 @@
 #define CSR_MHPMCOUNTER29		0xb1d
 #define CSR_MHPMCOUNTER30		0xb1e
 #define CSR_MHPMCOUNTER31		0xb1f
+#define CSR_MCOUNTINHIBIT		0x320
 #define CSR_MHPMEVENT3			0x323
 #define CSR_MHPMEVENT4			0x324
 #define CSR_MHPMEVENT5			0x325
@@ -332,6 +335,15 @@
 #define CSR_MHPMEVENT29			0x33d
 #define CSR_MHPMEVENT30			0x33e
 #define CSR_MHPMEVENT31			0x33f
+/* mhpmeventX bits of the Sscofpmf extension, RV64 only */
+#define MHPMEVENT_OF			(_ULL(1) << 63)
+#define MHPMEVENT_MINH			(_ULL(1) << 62)
+#define MHPMEVENT_SINH			(_ULL(1) << 61)
+#define MHPMEVENT_UINH			(_ULL(1) << 60)
+#define MHPMEVENT_VSINH			(_ULL(1) << 59)
+#define MHPMEVENT_VUINH			(_ULL(1) << 58)
+#define MHPMEVENT_SSCOF_MASK		_ULL(0xFC00000000000000)
+
 #define CSR_MVENDORID			0xf11
 #define CSR_MARCHID			0xf12
 #define CSR_MIMPID			0xf13
@@ -492,6 +504,10 @@
 #define INSN_MASK_WFI			0xffffff00
 #define INSN_MATCH_WFI			0x10500000
 
+/* CSRRS rd, csr, x0 (also known as CSRR rd, csr) */
+#define INSN_MASK_CSRR			0x000ff07f
+#define INSN_MATCH_CSRR			0x00002073
+
 #define INSN_16BIT_MASK			0x3
 #define INSN_32BIT_MASK			0x1c
 
@@ -22,6 +22,12 @@ void sbi_putc(char ch);
 
 void sbi_puts(const char *str);
 
+unsigned long sbi_console_write(const char *str, unsigned long len);
+
+void sbi_console_drain(void);
+
+void sbi_console_flush(void);
+
 void sbi_gets(char *s, int maxwidth, char endchar);
 
 int __printf(2, 3) sbi_sprintf(char *out, const char *format, ...);
@@ -33,23 +33,42 @@ struct sbi_ecall_extension {
 		       struct sbi_trap_info *out_trap);
 };
 
+/** Per-HART ecall dispatch statistics (SBI_ECALL_PROFILE builds only) */
+struct sbi_ecall_stats {
+	/** Number of ecalls handled */
+	unsigned long count;
+	/** Total mcycle spent dispatching and handling them */
+	unsigned long cycles;
+	/** mcycle spent on the last completed ecall */
+	unsigned long last;
+};
+
 extern struct sbi_ecall_extension ecall_base;
 extern struct sbi_ecall_extension ecall_legacy;
 extern struct sbi_ecall_extension ecall_time;
 extern struct sbi_ecall_extension ecall_rfence;
 extern struct sbi_ecall_extension ecall_ipi;
+extern struct sbi_ecall_extension ecall_dbcn;
+extern struct sbi_ecall_extension ecall_hsm;
+extern struct sbi_ecall_extension ecall_pmu;
 extern struct sbi_ecall_extension ecall_vendor;
+extern struct sbi_ecall_extension ecall_penglai;
+extern struct sbi_ecall_extension ecall_profile;
 
 u16 sbi_ecall_version_major(void);
 
 u16 sbi_ecall_version_minor(void);
 
+struct sbi_ecall_stats *sbi_ecall_stats_ptr(struct sbi_scratch *scratch);
+
 struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid);
 
 int sbi_ecall_register_extension(struct sbi_ecall_extension *ext);
 
 void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext);
 
+bool sbi_ecall_penglai_switch(struct sbi_trap_regs *regs);
+
 int sbi_ecall_handler(u32 hartid, ulong mcause, struct sbi_trap_regs *regs,
 		      struct sbi_scratch *scratch);
 
@@ -26,6 +26,10 @@
 #define SBI_EXT_TIME				0x54494D45
 #define SBI_EXT_IPI				0x735049
 #define SBI_EXT_RFENCE				0x52464E43
+#define SBI_EXT_HSM				0x48534D
+#define SBI_EXT_DBCN				0x4442434E
+#define SBI_EXT_PMU				0x504D55
+#define SBI_EXT_PROFILE				0x08000000
 
 /* SBI function IDs for BASE extension*/
 #define SBI_EXT_BASE_GET_SPEC_VERSION		0x0
@@ -35,7 +39,7 @@
 #define SBI_EXT_BASE_GET_MVENDORID		0x4
 #define SBI_EXT_BASE_GET_MARCHID		0x5
 #define SBI_EXT_BASE_GET_MIMPID			0x6
-// SBI CALL NUMBERS for Penglai Enclave
+/* SBI function IDs for Penglai enclave extension */
 #define SBI_MM_INIT            100
 #define SBI_CREATE_ENCLAVE      99
 #define SBI_ATTEST_ENCLAVE      98
@@ -49,6 +53,19 @@
 #define SBI_ENCLAVE_OCALL       90
 #define SBI_EXIT_ENCLAVE        89
 #define SBI_DEBUG_PRINT         88
+/* Function IDs older drivers and enclaves may still issue on BASE */
+#define SBI_PENGLAI_LEGACY_FID_MIN	SBI_DEBUG_PRINT
+#define SBI_PENGLAI_LEGACY_FID_MAX	SBI_MM_INIT
+/* Function IDs only available on the Penglai extension */
+#define SBI_TEMPLATE_CREATE     86
+#define SBI_TEMPLATE_CLONE      85
+#define SBI_TEMPLATE_DESTROY    84
+#define SBI_SHM_CREATE          83
+#define SBI_SHM_GRANT           82
+#define SBI_SHM_REVOKE          81
+#define SBI_SHM_DESTROY         80
+#define SBI_HART_ASSIGN         79
+#define SBI_HART_RELEASE        78
 
 /* SBI function IDs for TIME extension*/
 #define SBI_EXT_TIME_SET_TIMER			0x0
@@ -56,6 +73,21 @@
 /* SBI function IDs for IPI extension*/
 #define SBI_EXT_IPI_SEND_IPI			0x0
 
+/* SBI function IDs for HSM extension*/
+#define SBI_EXT_HSM_HART_START			0x0
+#define SBI_EXT_HSM_HART_STOP			0x1
+#define SBI_EXT_HSM_HART_GET_STATUS		0x2
+
+#define SBI_HSM_HART_STATUS_STARTED		0x0
+#define SBI_HSM_HART_STATUS_STOPPED		0x1
+#define SBI_HSM_HART_STATUS_START_PENDING	0x2
+#define SBI_HSM_HART_STATUS_STOP_PENDING	0x3
+
+/* SBI function IDs for DBCN extension*/
+#define SBI_EXT_DBCN_CONSOLE_WRITE		0x0
+#define SBI_EXT_DBCN_CONSOLE_READ		0x1
+#define SBI_EXT_DBCN_CONSOLE_WRITE_BYTE		0x2
+
 /* SBI function IDs for RFENCE extension*/
 #define SBI_EXT_RFENCE_REMOTE_FENCE_I		0x0
 #define SBI_EXT_RFENCE_REMOTE_SFENCE_VMA	0x1
@@ -64,12 +96,63 @@
 #define SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID	0x4
 #define SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA	0x5
 #define SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID	0x6
+/* OpenSBI specific asynchronous completion mode for RFENCE extension */
+#define SBI_EXT_RFENCE_ASYNC_FLAG		0x100
+#define SBI_EXT_RFENCE_TICKET_POLL		0x200
+#define SBI_EXT_RFENCE_TICKET_WAIT		0x201
+
+/* SBI function IDs for PMU extension */
+#define SBI_EXT_PMU_NUM_COUNTERS		0x0
+#define SBI_EXT_PMU_COUNTER_GET_INFO		0x1
+#define SBI_EXT_PMU_COUNTER_CFG_MATCH		0x2
+#define SBI_EXT_PMU_COUNTER_START		0x3
+#define SBI_EXT_PMU_COUNTER_STOP		0x4
+
+#define SBI_PMU_CFG_FLAG_SKIP_MATCH		(1UL << 0)
+#define SBI_PMU_CFG_FLAG_CLEAR_VALUE		(1UL << 1)
+#define SBI_PMU_CFG_FLAG_AUTO_START		(1UL << 2)
+#define SBI_PMU_CFG_FLAG_SET_VUINH		(1UL << 3)
+#define SBI_PMU_CFG_FLAG_SET_VSINH		(1UL << 4)
+#define SBI_PMU_CFG_FLAG_SET_UINH		(1UL << 5)
+#define SBI_PMU_CFG_FLAG_SET_SINH		(1UL << 6)
+#define SBI_PMU_CFG_FLAG_SET_MINH		(1UL << 7)
+
+#define SBI_PMU_START_FLAG_SET_INIT_VALUE	(1UL << 0)
+#define SBI_PMU_STOP_FLAG_RESET			(1UL << 0)
+
+/*
+ * OpenSBI specific hart_mask_base for IPI and RFENCE: hart_mask is then
+ * the S-mode address of a bitmap of HART IDs covering all the HARTs
+ */
+#define SBI_HART_MASK_BASE_SHMEM		-2UL
+
+/* OpenSBI specific function IDs for PROFILE extension */
+#define SBI_EXT_PROFILE_NOP			0x0
+#define SBI_EXT_PROFILE_ECALL_COUNT		0x1
+#define SBI_EXT_PROFILE_ECALL_CYCLES		0x2
+#define SBI_EXT_PROFILE_ECALL_LAST		0x3
+#define SBI_EXT_PROFILE_RESET			0x4
+#define SBI_EXT_PROFILE_MISALIGNED_COUNT	0x5
+#define SBI_EXT_PROFILE_MISALIGNED_PC		0x6
+#define SBI_EXT_PROFILE_MISALIGNED_HITS		0x7
+#define SBI_EXT_PROFILE_MISALIGNED_RESET	0x8
+#define SBI_EXT_PROFILE_TRACE_START		0x9
+#define SBI_EXT_PROFILE_TRACE_STOP		0xa
+#define SBI_EXT_PROFILE_SWITCH_COUNT		0xb
+#define SBI_EXT_PROFILE_SWITCH_CYCLES		0xc
+#define SBI_EXT_PROFILE_SWITCH_MAX		0xd
+#define SBI_EXT_PROFILE_SWITCH_FP		0xe
+#define SBI_EXT_PROFILE_SWITCH_RESET		0xf
 
 #define SBI_SPEC_VERSION_MAJOR_OFFSET		24
 #define SBI_SPEC_VERSION_MAJOR_MASK		0x7f
 #define SBI_SPEC_VERSION_MINOR_MASK		0xffffff
+#define SBI_EXT_EXPERIMENTAL_START		0x08000000
+#define SBI_EXT_EXPERIMENTAL_END		0x08FFFFFF
 #define SBI_EXT_VENDOR_START			0x09000000
 #define SBI_EXT_VENDOR_END			0x09FFFFFF
+/* First vendor extension ID is taken by the Penglai enclave monitor */
+#define SBI_EXT_PENGLAI				SBI_EXT_VENDOR_START
 /* clang-format on */
 
 #endif
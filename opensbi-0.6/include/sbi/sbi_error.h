@@ -29,6 +29,9 @@
 #define SBI_EUNKNOWN	-14
 #define SBI_ENOENT	-15
 
+/* SBI_ERR_ALREADY_STARTED of the spec, SBI_ENOSYS is never returned */
+#define SBI_EALREADY	-7
+
 /* clang-format on */
 
 #endif
@@ -15,6 +15,9 @@
 struct sbi_trap_regs;
 struct sbi_scratch;
 
+int sbi_illegal_insn_counter_fast(ulong insn, struct sbi_trap_regs *regs,
+				  struct sbi_scratch *scratch);
+
 int sbi_illegal_insn_handler(u32 hartid, ulong mcause, ulong insn,
 			     struct sbi_trap_regs *regs,
 			     struct sbi_scratch *scratch);
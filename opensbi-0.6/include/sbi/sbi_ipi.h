@@ -26,16 +26,17 @@ struct sbi_ipi_event_ops {
 	char name[32];
 
 	/** Update callback to save/enqueue data for remote HART
-	 *  Note: This is an optional callback and it is called just before
-	 *  triggering IPI to remote HART.
+	 *  Note: This is an optional callback and it is called for every
+	 *  remote HART before triggering IPIs to any of them. A negative
+	 *  return value means no IPI is needed for that remote HART.
 	 */
 	int (* update)(struct sbi_scratch *scratch,
 			struct sbi_scratch *remote_scratch,
 			u32 remote_hartid, void *data);
 
-	/** Sync callback to wait for remote HART
-	 *  Note: This is an optional callback and it is called just after
-	 *  triggering IPI to remote HART.
+	/** Sync callback to wait for remote HARTs
+	 *  Note: This is an optional callback and it is called once just
+	 *  after triggering IPIs to all the remote HARTs.
 	 */
 	void (* sync)(struct sbi_scratch *scratch);
 
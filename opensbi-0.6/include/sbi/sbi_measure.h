@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_MEASURE_H__
+#define __SBI_MEASURE_H__
+
+#include <sbi/sbi_sha256.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Largest number of pages in one measurement (4 GiB) */
+#define SBI_MEASURE_MAX_PAGES		(1UL << 20)
+/** Pages claimed at once by a measuring HART */
+#define SBI_MEASURE_BATCH		16
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+/**
+ * Page-level Merkle measurement of a physically contiguous region
+ *
+ * Every page gets a leaf digest SHA-256(0x00 || page). The root is the
+ * RFC 6962 tree over the leaves with nodes SHA-256(0x01 || left ||
+ * right). Leaf digests are kept by the caller so that only changed
+ * pages are hashed again on the next measurement.
+ */
+struct sbi_measure_req {
+	/** Physical base of the region, page aligned */
+	unsigned long base;
+	/** Number of pages */
+	unsigned long count;
+	/** Leaf digest of every page */
+	u8 (*digests)[SBI_SHA256_DIGEST_SIZE];
+	/**
+	 * Bitmap of pages changed since their digest was computed, cleared
+	 * as they are hashed. NULL means every page is hashed.
+	 */
+	volatile unsigned long *dirty;
+	/** Merkle root, left as is when no page changed */
+	u8 root[SBI_SHA256_DIGEST_SIZE];
+};
+
+int sbi_measure_pages(struct sbi_scratch *scratch,
+		      struct sbi_measure_req *req, ulong hmask);
+
+int sbi_measure_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
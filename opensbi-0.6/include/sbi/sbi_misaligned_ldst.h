@@ -15,6 +15,21 @@
 struct sbi_trap_regs;
 struct sbi_scratch;
 
+/** Number of PCs tracked per HART for misaligned traps */
+#define SBI_MISALIGNED_STATS_SLOTS	16
+
+/** Per-HART misaligned load/store trap statistics */
+struct sbi_misaligned_stats {
+	/** Number of misaligned loads and stores emulated */
+	unsigned long count;
+	/** Trapping PC of each slot */
+	unsigned long pc[SBI_MISALIGNED_STATS_SLOTS];
+	/** Approximate trap count of each slot */
+	unsigned long hits[SBI_MISALIGNED_STATS_SLOTS];
+};
+
+struct sbi_misaligned_stats *sbi_misaligned_stats_ptr(struct sbi_scratch *scratch);
+
 int sbi_misaligned_load_handler(u32 hartid, ulong mcause,
 				ulong addr, ulong tval2, ulong tinst,
 				struct sbi_trap_regs *regs,
@@ -25,4 +40,6 @@ int sbi_misaligned_store_handler(u32 hartid, ulong mcause,
 				 struct sbi_trap_regs *regs,
 				 struct sbi_scratch *scratch);
 
+int sbi_misaligned_init(struct sbi_scratch *scratch, bool cold_boot);
+
 #endif
@@ -0,0 +1,87 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_PENGLAI_CTX_H__
+#define __SBI_PENGLAI_CTX_H__
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Kinds of world switch, as timed by the Penglai fast path */
+#define SBI_PENGLAI_SWITCH_RUN		0
+#define SBI_PENGLAI_SWITCH_RESUME	1
+#define SBI_PENGLAI_SWITCH_OCALL	2
+#define SBI_PENGLAI_SWITCH_EXIT		3
+#define SBI_PENGLAI_SWITCH_KINDS	4
+
+/** Counters of the lazy FP switch */
+#define SBI_PENGLAI_FP_SAVED		0
+#define SBI_PENGLAI_FP_RESTORED		1
+#define SBI_PENGLAI_FP_SKIPPED		2
+#define SBI_PENGLAI_FP_COUNTERS		3
+
+/** Values of the mstatus.FS field */
+#define SBI_PENGLAI_FS_OFF		_UL(0x00000000)
+#define SBI_PENGLAI_FS_INITIAL		_UL(0x00002000)
+#define SBI_PENGLAI_FS_CLEAN		_UL(0x00004000)
+#define SBI_PENGLAI_FS_DIRTY		_UL(0x00006000)
+
+/* clang-format on */
+
+struct sbi_scratch;
+struct sbi_trap_regs;
+
+/** Floating-point state of one side of a world switch */
+struct sbi_penglai_fp_ctx {
+	u64 f[32];
+	unsigned long fcsr;
+	/** Unique among all contexts ever initialized */
+	unsigned long id;
+	/** mstatus.FS and mstatus.XS of the context */
+	unsigned long status;
+	/**
+	 * The host kernel relies on FS to know what to save itself, so its
+	 * Dirty state is handed back as is. Other contexts are marked Clean
+	 * once saved or restored, so an unmodified image is never saved
+	 * twice.
+	 */
+	bool host;
+};
+
+/** Per-HART world switch statistics */
+struct sbi_penglai_ctx_stats {
+	/** Number of switches of each kind */
+	unsigned long count[SBI_PENGLAI_SWITCH_KINDS];
+	/** Total mcycle spent in switches of each kind */
+	unsigned long cycles[SBI_PENGLAI_SWITCH_KINDS];
+	/** Slowest switch of each kind */
+	unsigned long max[SBI_PENGLAI_SWITCH_KINDS];
+	/** FP images saved, restored and restores skipped */
+	unsigned long fp[SBI_PENGLAI_FP_COUNTERS];
+};
+
+void sbi_penglai_fp_ctx_init(struct sbi_penglai_fp_ctx *ctx, bool host);
+
+void sbi_penglai_fp_switch(struct sbi_scratch *scratch,
+			   struct sbi_trap_regs *regs,
+			   struct sbi_penglai_fp_ctx *prev,
+			   struct sbi_penglai_fp_ctx *next);
+
+static inline unsigned long sbi_penglai_switch_begin(void)
+{
+	return csr_read(CSR_MCYCLE);
+}
+
+void sbi_penglai_switch_end(struct sbi_scratch *scratch, u32 kind,
+			    unsigned long start);
+
+struct sbi_penglai_ctx_stats *
+sbi_penglai_ctx_stats_ptr(struct sbi_scratch *scratch);
+
+int sbi_penglai_ctx_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
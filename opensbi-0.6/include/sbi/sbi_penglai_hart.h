@@ -0,0 +1,25 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_PENGLAI_HART_H__
+#define __SBI_PENGLAI_HART_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+int sbi_penglai_hart_assign(struct sbi_scratch *scratch, u32 hartid,
+			    unsigned long eid);
+
+int sbi_penglai_hart_release(struct sbi_scratch *scratch, u32 hartid);
+
+bool sbi_penglai_hart_is_host(u32 hartid);
+
+void sbi_penglai_hart_filter(ulong *hmask, ulong *hbase);
+
+void sbi_penglai_hart_stop_pending(struct sbi_scratch *scratch);
+
+int sbi_penglai_hart_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
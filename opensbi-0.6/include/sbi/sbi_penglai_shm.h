@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_PENGLAI_SHM_H__
+#define __SBI_PENGLAI_SHM_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Maximum number of live shared regions */
+#define SBI_PENGLAI_SHM_MAX		16
+/** Maximum number of enclaves a region is granted to */
+#define SBI_PENGLAI_SHM_MAX_GRANTS	8
+
+/** Region lives in host memory and may be mapped by the host */
+#define SBI_PENGLAI_SHM_HOST		0x1
+
+/** Access granted to an enclave */
+#define SBI_PENGLAI_SHM_READ		0x1
+#define SBI_PENGLAI_SHM_WRITE		0x2
+
+/* clang-format on */
+
+int sbi_penglai_shm_create(unsigned long key, unsigned long paddr,
+			   unsigned long size, unsigned long *id);
+
+int sbi_penglai_shm_lookup(unsigned long key, unsigned long *id);
+
+int sbi_penglai_shm_grant(unsigned long id, unsigned long eid,
+			  unsigned long prot, unsigned long *va);
+
+int sbi_penglai_shm_revoke(unsigned long id, unsigned long eid);
+
+void sbi_penglai_shm_revoke_all(unsigned long eid);
+
+int sbi_penglai_shm_destroy(unsigned long id);
+
+int sbi_penglai_shm_exclude(unsigned long base, unsigned long size,
+			    int (*fn)(unsigned long base, unsigned long size));
+
+#endif
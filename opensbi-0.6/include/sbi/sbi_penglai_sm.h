@@ -0,0 +1,27 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 IPADS, Shanghai Jiao Tong University.
+ *
+ * Authors:
+ *   Penglai Enclave developers
+ */
+
+#ifndef __SBI_PENGLAI_SM_H__
+#define __SBI_PENGLAI_SM_H__
+
+#include <sbi/sbi_types.h>
+
+/* Penglai SM entry points shared by several firmware files, see sm/sm.h */
+
+uintptr_t sm_mm_init(uintptr_t paddr, unsigned long size);
+
+uintptr_t sm_mm_extend(uintptr_t paddr, unsigned long size);
+
+/** Enclave ID running on current HART, negative in the host world */
+int check_in_enclave_world(void);
+
+/** Non-zero if the range overlaps the SM or any secure memory region */
+int check_mem_overlap(uintptr_t paddr, unsigned long size);
+
+#endif
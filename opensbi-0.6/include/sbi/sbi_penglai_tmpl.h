@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_PENGLAI_TMPL_H__
+#define __SBI_PENGLAI_TMPL_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Maximum number of live enclave templates */
+#define SBI_PENGLAI_TMPL_MAX		8
+/** Size of an enclave measurement */
+#define SBI_PENGLAI_HASH_SIZE		32
+
+/* clang-format on */
+
+/**
+ * Frozen enclave image shared by the clones of a template
+ *
+ * The SM fills this in when an enclave is turned into a template. From
+ * then on the memory is never written again: clones map its pages
+ * read-only and get private copies of writable pages on first write.
+ */
+struct sbi_penglai_tmpl_image {
+	/** Physical base of the template enclave memory */
+	unsigned long paddr;
+	/** Size of the template enclave memory */
+	unsigned long size;
+	/** Measurement of the template, reported by every clone */
+	unsigned char hash[SBI_PENGLAI_HASH_SIZE];
+};
+
+int sbi_penglai_tmpl_create(unsigned long eid, unsigned long *id);
+
+int sbi_penglai_tmpl_get(unsigned long id,
+			 const struct sbi_penglai_tmpl_image **image);
+
+void sbi_penglai_tmpl_put(unsigned long id);
+
+int sbi_penglai_tmpl_destroy(unsigned long id);
+
+int sbi_penglai_tmpl_cow(unsigned long id, unsigned long src,
+			 unsigned long dst);
+
+#endif
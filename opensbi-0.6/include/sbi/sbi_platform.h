@@ -37,6 +37,12 @@
 
 #define SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT		(1UL << 12)
 
+/** Stack left to each HART once its scratch space is carved out */
+#define SBI_PLATFORM_HART_STACK_MIN		8192
+/** Per-HART stack region platforms should use, scratch space included */
+#define SBI_PLATFORM_DEFAULT_HART_STACK_SIZE	\
+	(SBI_PLATFORM_HART_STACK_MIN + SBI_SCRATCH_SIZE)
+
 #ifndef __ASSEMBLY__
 
 #include <sbi/sbi_ecall.h>
@@ -112,6 +118,8 @@ struct sbi_platform_operations {
 
 	/** Send IPI to a target HART */
 	void (*ipi_send)(u32 target_hart);
+	/** Send IPI to a set of target HARTs at once */
+	void (*ipi_send_many)(ulong hmask);
 	/** Clear IPI for a target HART */
 	void (*ipi_clear)(u32 target_hart);
 	/** Initialize IPI for current HART */
@@ -484,6 +492,36 @@ static inline void sbi_platform_ipi_send(const struct sbi_platform *plat,
 		sbi_platform_ops(plat)->ipi_send(target_hart);
 }
 
+/**
+ * Send IPI to a set of target HARTs
+ *
+ * Platforms without a multicast capable IPI device get one
+ * ipi_send() per target HART, issued back-to-back.
+ *
+ * @param plat pointer to struct sbi_platform
+ * @param hmask mask of target HART IDs
+ */
+static inline void sbi_platform_ipi_send_many(const struct sbi_platform *plat,
+					      ulong hmask)
+{
+	u32 i;
+
+	if (!plat)
+		return;
+
+	if (sbi_platform_ops(plat)->ipi_send_many) {
+		sbi_platform_ops(plat)->ipi_send_many(hmask);
+		return;
+	}
+
+	if (!sbi_platform_ops(plat)->ipi_send)
+		return;
+
+	for (i = 0; hmask; i++, hmask >>= 1)
+		if (hmask & 1UL)
+			sbi_platform_ops(plat)->ipi_send(i);
+}
+
 /**
  * Clear IPI for a target HART
  *
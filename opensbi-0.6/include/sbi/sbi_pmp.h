@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_PMP_H__
+#define __SBI_PMP_H__
+
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+/** Encoded PMP entry */
+struct sbi_pmp_entry {
+	/** Value of the pmpcfg byte */
+	unsigned long cfg;
+	/** Value of the pmpaddr CSR */
+	unsigned long addr;
+};
+
+/** Set of PMP entries programmed together on consecutive indexes */
+struct sbi_pmp_layout {
+	/** Number of entries used */
+	u32 count;
+	/** Encoded entries */
+	struct sbi_pmp_entry entries[PMP_COUNT];
+};
+
+void sbi_pmp_layout_init(struct sbi_pmp_layout *layout);
+
+int sbi_pmp_layout_add_napot(struct sbi_pmp_layout *layout, unsigned long prot,
+			     unsigned long addr, unsigned long log2len);
+
+int sbi_pmp_layout_add(struct sbi_pmp_layout *layout, unsigned long prot,
+		       unsigned long addr, unsigned long size);
+
+int sbi_pmp_layout_add_tor(struct sbi_pmp_layout *layout, unsigned long prot,
+			   unsigned long addr, unsigned long size);
+
+int sbi_pmp_apply(struct sbi_scratch *scratch, u32 first,
+		  const struct sbi_pmp_layout *layout);
+
+int sbi_pmp_update(struct sbi_scratch *scratch, u32 first,
+		   const struct sbi_pmp_layout *layout);
+
+void sbi_pmp_shadow_update(u32 n, unsigned long cfg, unsigned long addr);
+
+bool sbi_pmp_range_protected(struct sbi_scratch *scratch, unsigned long base,
+			     unsigned long size);
+
+void sbi_pmp_reserve(struct sbi_scratch *scratch, u32 count);
+
+u32 sbi_pmp_first_free(struct sbi_scratch *scratch);
+
+int sbi_pmp_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
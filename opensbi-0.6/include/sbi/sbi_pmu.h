@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_PMU_H__
+#define __SBI_PMU_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Counter indexes are the offsets of the counter CSRs from cycle */
+#define SBI_PMU_CTR_CYCLE		0
+#define SBI_PMU_CTR_TIME		1
+#define SBI_PMU_CTR_INSTRET		2
+#define SBI_PMU_CTR_HPM_FIRST		3
+#define SBI_PMU_CTR_MAX			32
+
+/** Event index: type in bits [19:16], code in bits [15:0] */
+#define SBI_PMU_EVENT_TYPE_SHIFT	16
+#define SBI_PMU_EVENT_TYPE_MASK		0xf
+#define SBI_PMU_EVENT_CODE_MASK		0xffff
+
+#define SBI_PMU_EVENT_TYPE_HW		0x0
+#define SBI_PMU_EVENT_TYPE_CACHE	0x1
+#define SBI_PMU_EVENT_TYPE_RAW		0x2
+#define SBI_PMU_EVENT_TYPE_FW		0xf
+
+#define SBI_PMU_HW_CPU_CYCLES		0x1
+#define SBI_PMU_HW_INSTRUCTIONS		0x2
+
+/** Maximum number of event ranges a platform can map */
+#define SBI_PMU_EVENT_MAP_MAX		16
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+int sbi_pmu_map_event(u32 eidx_start, u32 eidx_end, unsigned long ctr_mask,
+		      u64 select);
+
+unsigned long sbi_pmu_num_counters(void);
+
+int sbi_pmu_counter_info(unsigned long cidx, unsigned long *info);
+
+int sbi_pmu_counter_cfg_match(struct sbi_scratch *scratch,
+			      unsigned long cidx_base, unsigned long cidx_mask,
+			      unsigned long flags, unsigned long event_idx,
+			      u64 event_data, unsigned long *out_cidx);
+
+int sbi_pmu_counter_start(struct sbi_scratch *scratch,
+			  unsigned long cidx_base, unsigned long cidx_mask,
+			  unsigned long flags, u64 ival);
+
+int sbi_pmu_counter_stop(struct sbi_scratch *scratch,
+			 unsigned long cidx_base, unsigned long cidx_mask,
+			 unsigned long flags);
+
+int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
@@ -37,7 +37,9 @@
 /** Offset of extra space in sbi_scratch */
 #define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(10 * __SIZEOF_POINTER__)
 /** Maximum size of sbi_scratch */
-#define SBI_SCRATCH_SIZE			(64 * __SIZEOF_POINTER__)
+#define SBI_SCRATCH_SIZE			(0x1000)
+/** Allocation granule of the extra space in sbi_scratch */
+#define SBI_SCRATCH_CACHELINE_SIZE		64
 
 /* clang-format on */
 
@@ -86,15 +88,31 @@ enum sbi_scratch_options {
 	((void *)(sbi_scratch_thishart_ptr()->next_arg1))
 
 /** Allocate from extra space in sbi_scratch
+ *
+ * Small allocations may share a cacheline with other owners.
  *
  * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
  * on success
  */
 unsigned long sbi_scratch_alloc_offset(unsigned long size, const char *owner);
 
+/** Allocate whole cachelines from extra space in sbi_scratch
+ *
+ * Use this for data written by remote HARTs so that it does not share a
+ * cacheline with anything else.
+ *
+ * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+ * on success
+ */
+unsigned long sbi_scratch_alloc_cacheline_offset(unsigned long size,
+						 const char *owner);
+
 /** Free-up extra space in sbi_scratch */
 void sbi_scratch_free_offset(unsigned long offset);
 
+/** Print the owner of every extra space allocation in sbi_scratch */
+void sbi_scratch_alloc_dump(void);
+
 /** Get pointer from offset in sbi_scratch */
 #define sbi_scratch_offset_ptr(scratch, offset)	((void *)scratch + (offset))
 
@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_SECMEM_H__
+#define __SBI_SECMEM_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_pmp_layout;
+struct sbi_scratch;
+
+/* clang-format off */
+
+/** Granule of the secure memory reserve */
+#define SBI_SECMEM_CHUNK_SHIFT		21
+#define SBI_SECMEM_CHUNK_SIZE		(1UL << SBI_SECMEM_CHUNK_SHIFT)
+
+/** First of the two PMP entries denying the reserve to the host */
+#define SBI_SECMEM_PMP_ENTRY		1
+/** Rounds a reclaim waits for the other HARTs to update their PMP */
+#define SBI_SECMEM_PMP_WAIT_SPINS	0x100000
+
+/** Ask the host for more memory below this many free bytes */
+#define SBI_SECMEM_LOW_WATERMARK	(4 * SBI_SECMEM_CHUNK_SIZE)
+/** Give memory back to the host only above this many free bytes */
+#define SBI_SECMEM_HIGH_WATERMARK	(32 * SBI_SECMEM_CHUNK_SIZE)
+
+/* clang-format on */
+
+int sbi_secmem_donate(unsigned long base, unsigned long size);
+
+unsigned long sbi_secmem_take(unsigned long size);
+
+int sbi_secmem_reclaim(unsigned long size, unsigned long *base);
+
+bool sbi_secmem_overlaps_reserve(unsigned long base, unsigned long size);
+
+unsigned long sbi_secmem_free_bytes(void);
+
+bool sbi_secmem_below_low_watermark(void);
+
+int sbi_secmem_pmp_layout(struct sbi_pmp_layout *layout);
+
+int sbi_secmem_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
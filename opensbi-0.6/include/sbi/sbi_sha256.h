@@ -0,0 +1,26 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_SHA256_H__
+#define __SBI_SHA256_H__
+
+#include <sbi/sbi_types.h>
+
+#define SBI_SHA256_DIGEST_SIZE		32
+#define SBI_SHA256_BLOCK_SIZE		64
+
+struct sbi_sha256_ctx {
+	u32 state[8];
+	u64 count;
+	u8 buf[SBI_SHA256_BLOCK_SIZE];
+};
+
+void sbi_sha256_init(struct sbi_sha256_ctx *ctx);
+
+void sbi_sha256_update(struct sbi_sha256_ctx *ctx, const void *data,
+		       unsigned long len);
+
+void sbi_sha256_final(struct sbi_sha256_ctx *ctx, u8 *digest);
+
+#endif
@@ -17,9 +17,21 @@
 
 #define SBI_TLB_FLUSH_ALL			((unsigned long)-1)
 
+/** Number of low bits of a completion ticket holding the source HART */
+#define SBI_TLB_TICKET_HART_BITS		8
+#define SBI_TLB_TICKET_HART_MASK		\
+	((1UL << SBI_TLB_TICKET_HART_BITS) - 1)
+
+/** Outstanding asynchronous requests per HART, must be a power of two */
+#define SBI_TLB_TICKET_SLOTS			16
+
+/** Rounds of ring draining a TICKET_WAIT call spins for at most */
+#define SBI_TLB_TICKET_WAIT_SPINS		4096
+
 /* clang-format on */
 
-#define SBI_TLB_FIFO_NUM_ENTRIES		8
+/* Must be a power of two */
+#define SBI_TLB_RING_NUM_ENTRIES		32
 
 enum sbi_tlb_info_types {
 	SBI_TLB_FLUSH_VMA,
@@ -38,7 +50,10 @@ struct sbi_tlb_info {
 	unsigned long size;
 	unsigned long asid;
 	unsigned long type;
+	/** Source HARTs waiting synchronously for this request */
 	unsigned long shart_mask;
+	/** Ticket of an asynchronous request, 0 for synchronous ones */
+	unsigned long ticket;
 };
 
 #define SBI_TLB_INFO_SIZE			sizeof(struct sbi_tlb_info)
@@ -46,6 +61,13 @@ struct sbi_tlb_info {
 int sbi_tlb_request(struct sbi_scratch *scratch, ulong hmask,
 		    ulong hbase, struct sbi_tlb_info *tinfo);
 
+int sbi_tlb_request_async(struct sbi_scratch *scratch, ulong hmask,
+			  ulong hbase, struct sbi_tlb_info *tinfo,
+			  unsigned long *ticket);
+
+int sbi_tlb_ticket_poll(struct sbi_scratch *scratch, unsigned long ticket,
+			bool wait, unsigned long *done);
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot);
 
 #endif
@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __SBI_TRACE_H__
+#define __SBI_TRACE_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+#define SBI_TRACE_ECALL_ENTER		0
+#define SBI_TRACE_ECALL_EXIT		1
+#define SBI_TRACE_TRAP			2
+#define SBI_TRACE_IPI			3
+#define SBI_TRACE_TLB_FLUSH		4
+#define SBI_TRACE_ENCLAVE		5
+#define SBI_TRACE_EVENT_MAX		6
+
+#define SBI_TRACE_EVENT_ALL		((1UL << SBI_TRACE_EVENT_MAX) - 1)
+
+/* clang-format on */
+
+struct sbi_scratch;
+
+/** One trace record, same layout on RV32 and RV64 */
+struct sbi_trace_record {
+	/** Timer value when the record was written */
+	u64 time;
+	/** SBI_TRACE_xxx event */
+	u32 event;
+	/** Event specific small value */
+	u32 info;
+	/** Event specific arguments */
+	u64 arg0;
+	u64 arg1;
+};
+
+/**
+ * Header of the trace buffer handed to a HART by S-mode
+ *
+ * Record n is written to records[n % entries] and head is advanced to
+ * n + 1 once the record is complete. The buffer is overwritten when
+ * S-mode does not keep up, so readers must check head again after
+ * copying records out to find the ones overwritten meanwhile.
+ */
+struct sbi_trace_ring {
+	/** Number of records written so far */
+	u64 head;
+	/** Number of record slots, a power of 2 */
+	u64 entries;
+	u64 reserved[2];
+	struct sbi_trace_record records[0];
+};
+
+void sbi_trace(struct sbi_scratch *scratch, u32 event, u32 info,
+	       unsigned long arg0, unsigned long arg1);
+
+int sbi_trace_start(struct sbi_scratch *scratch, unsigned long base,
+		    unsigned long size, unsigned long mask);
+
+void sbi_trace_stop(struct sbi_scratch *scratch);
+
+int sbi_trace_exclude(struct sbi_scratch *scratch, unsigned long base,
+		      unsigned long size,
+		      int (*fn)(unsigned long base, unsigned long size));
+
+int sbi_trace_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#endif
@@ -15,21 +15,37 @@ libsbi-objs-y += riscv_locks.o
 libsbi-objs-y += sbi_console.o
 libsbi-objs-y += sbi_ecall.o
 libsbi-objs-y += sbi_ecall_base.o
+libsbi-objs-y += sbi_ecall_dbcn.o
+libsbi-objs-y += sbi_ecall_hsm.o
 libsbi-objs-y += sbi_ecall_legacy.o
+libsbi-objs-y += sbi_ecall_penglai.o
+libsbi-objs-y += sbi_ecall_pmu.o
+libsbi-objs-y += sbi_ecall_profile.o
 libsbi-objs-y += sbi_ecall_replace.o
 libsbi-objs-y += sbi_ecall_vendor.o
 libsbi-objs-y += sbi_emulate_csr.o
 libsbi-objs-y += sbi_fifo.o
 libsbi-objs-y += sbi_hfence.o
 libsbi-objs-y += sbi_hart.o
+libsbi-objs-y += sbi_hsm.o
 libsbi-objs-y += sbi_illegal_insn.o
 libsbi-objs-y += sbi_init.o
 libsbi-objs-y += sbi_ipi.o
+libsbi-objs-y += sbi_measure.o
 libsbi-objs-y += sbi_misaligned_ldst.o
+libsbi-objs-y += sbi_penglai_ctx.o
+libsbi-objs-y += sbi_penglai_hart.o
+libsbi-objs-y += sbi_penglai_shm.o
+libsbi-objs-y += sbi_penglai_tmpl.o
+libsbi-objs-y += sbi_pmp.o
+libsbi-objs-y += sbi_pmu.o
 libsbi-objs-y += sbi_scratch.o
+libsbi-objs-y += sbi_secmem.o
+libsbi-objs-y += sbi_sha256.o
 libsbi-objs-y += sbi_system.o
 libsbi-objs-y += sbi_timer.o
 libsbi-objs-y += sbi_tlb.o
+libsbi-objs-y += sbi_trace.o
 libsbi-objs-y += sbi_trap.o
 libsbi-objs-y += sbi_string.o
 libsbi-objs-y += sbi_unpriv.o
@@ -11,6 +11,7 @@
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmp.h>
 
 /* determine CPU extension, return non-zero support */
 int misa_extension_imp(char ext)
@@ -44,6 +45,51 @@ int misa_xlen(void)
 	return r ? r : -1;
 }
 
+#define switchcase_csr_read(__csr_num, __val)		\
+	case __csr_num:					\
+		__val = csr_read(__csr_num);		\
+		break;
+#define switchcase_csr_read_2(__csr_num, __val)		\
+	switchcase_csr_read(__csr_num + 0, __val)	\
+	switchcase_csr_read(__csr_num + 1, __val)
+#define switchcase_csr_read_4(__csr_num, __val)		\
+	switchcase_csr_read_2(__csr_num + 0, __val)	\
+	switchcase_csr_read_2(__csr_num + 2, __val)
+#define switchcase_csr_read_8(__csr_num, __val)		\
+	switchcase_csr_read_4(__csr_num + 0, __val)	\
+	switchcase_csr_read_4(__csr_num + 4, __val)
+#define switchcase_csr_read_16(__csr_num, __val)	\
+	switchcase_csr_read_8(__csr_num + 0, __val)	\
+	switchcase_csr_read_8(__csr_num + 8, __val)
+/* The 29 CSRs of hpmcounter3..31 or hpmevent3..31, from the 3rd one */
+#define switchcase_csr_read_hpm(__csr_num, __val)	\
+	switchcase_csr_read(__csr_num + 0, __val)	\
+	switchcase_csr_read_4(__csr_num + 1, __val)	\
+	switchcase_csr_read_8(__csr_num + 5, __val)	\
+	switchcase_csr_read_16(__csr_num + 13, __val)
+
+#define switchcase_csr_write(__csr_num, __val)		\
+	case __csr_num:					\
+		csr_write(__csr_num, __val);		\
+		break;
+#define switchcase_csr_write_2(__csr_num, __val)	\
+	switchcase_csr_write(__csr_num + 0, __val)	\
+	switchcase_csr_write(__csr_num + 1, __val)
+#define switchcase_csr_write_4(__csr_num, __val)	\
+	switchcase_csr_write_2(__csr_num + 0, __val)	\
+	switchcase_csr_write_2(__csr_num + 2, __val)
+#define switchcase_csr_write_8(__csr_num, __val)	\
+	switchcase_csr_write_4(__csr_num + 0, __val)	\
+	switchcase_csr_write_4(__csr_num + 4, __val)
+#define switchcase_csr_write_16(__csr_num, __val)	\
+	switchcase_csr_write_8(__csr_num + 0, __val)	\
+	switchcase_csr_write_8(__csr_num + 8, __val)
+#define switchcase_csr_write_hpm(__csr_num, __val)	\
+	switchcase_csr_write(__csr_num + 0, __val)	\
+	switchcase_csr_write_4(__csr_num + 1, __val)	\
+	switchcase_csr_write_8(__csr_num + 5, __val)	\
+	switchcase_csr_write_16(__csr_num + 13, __val)
+
 unsigned long csr_read_num(int csr_num)
 {
 	unsigned long ret = 0;
@@ -109,6 +155,16 @@ unsigned long csr_read_num(int csr_num)
 	case CSR_PMPADDR15:
 		ret = csr_read(CSR_PMPADDR15);
 		break;
+	/* Counters and event selectors, for the PMU extension */
+	switchcase_csr_read(CSR_MCYCLE, ret)
+	switchcase_csr_read(CSR_MINSTRET, ret)
+	switchcase_csr_read_hpm(CSR_MHPMCOUNTER3, ret)
+	switchcase_csr_read_hpm(CSR_MHPMEVENT3, ret)
+#if __riscv_xlen == 32
+	switchcase_csr_read(CSR_MCYCLEH, ret)
+	switchcase_csr_read(CSR_MINSTRETH, ret)
+	switchcase_csr_read_hpm(CSR_MHPMCOUNTER3H, ret)
+#endif
 	default:
 		break;
 	};
@@ -179,6 +235,15 @@ void csr_write_num(int csr_num, unsigned long val)
 	case CSR_PMPADDR15:
 		csr_write(CSR_PMPADDR15, val);
 		break;
+	switchcase_csr_write(CSR_MCYCLE, val)
+	switchcase_csr_write(CSR_MINSTRET, val)
+	switchcase_csr_write_hpm(CSR_MHPMCOUNTER3, val)
+	switchcase_csr_write_hpm(CSR_MHPMEVENT3, val)
+#if __riscv_xlen == 32
+	switchcase_csr_write(CSR_MCYCLEH, val)
+	switchcase_csr_write(CSR_MINSTRETH, val)
+	switchcase_csr_write_hpm(CSR_MHPMCOUNTER3H, val)
+#endif
 	default:
 		break;
 	};
@@ -244,6 +309,7 @@ int pmp_set(unsigned int n, unsigned long prot, unsigned long addr,
 	/* write csrs */
 	csr_write_num(pmpaddr_csr, pmpaddr);
 	csr_write_num(pmpcfg_csr, pmpcfg);
+	sbi_pmp_shadow_update(n, pmpcfg >> pmpcfg_shift, pmpaddr);
 
 	return 0;
 }
@@ -209,6 +209,18 @@ unsigned long atomic_raw_xchg_ulong(volatile unsigned long *ptr,
 #endif
 }
 
+unsigned long atomic_raw_cmpxchg_ulong(volatile unsigned long *ptr,
+				       unsigned long oldval,
+				       unsigned long newval)
+{
+	/* Atomically compare and set new value and return old value. */
+#ifdef __riscv_atomic
+	return __sync_val_compare_and_swap(ptr, oldval, newval);
+#else
+	return cmpxchg(ptr, oldval, newval);
+#endif
+}
+
 #if (BITS_PER_LONG == 64)
 #define __AMO(op) "amo" #op ".d"
 #elif (BITS_PER_LONG == 32)
@@ -7,12 +7,42 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/riscv_locks.h>
 
+/* clang-format off */
+
+#define CONSOLE_BUF_SIZE	256
+#define CONSOLE_DRAIN_BUDGET	128
+
+/* clang-format on */
+
+/*
+ * Per-HART output buffer. Only the owning HART advances head and only
+ * the holder of console_out_lock advances tail, so a HART can queue
+ * output without waiting for the UART or for other HARTs.
+ */
+struct console_buf {
+	volatile unsigned long head;
+	volatile unsigned long tail;
+	char data[CONSOLE_BUF_SIZE];
+};
+
 static const struct sbi_platform *console_plat = NULL;
 static spinlock_t console_out_lock	       = SPIN_LOCK_INITIALIZER;
+static unsigned long console_buf_off;
+
+static struct console_buf *console_buf_ptr(struct sbi_scratch *scratch)
+{
+	if (!console_buf_off || !scratch)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, console_buf_off);
+}
 
 bool sbi_isprintable(char c)
 {
@@ -35,14 +65,149 @@ void sbi_putc(char ch)
 	sbi_platform_console_putc(console_plat, ch);
 }
 
-void sbi_puts(const char *str)
+/* Emit up to budget bytes queued by all HARTs, console_out_lock held */
+static unsigned long console_drain_locked(unsigned long budget)
+{
+	u32 i;
+	unsigned long head, tail, emitted = 0;
+	struct console_buf *cb;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	for (i = 0; i < sbi_platform_hart_count(console_plat); i++) {
+		cb = console_buf_ptr(sbi_hart_id_to_scratch(scratch, i));
+		if (!cb)
+			continue;
+
+		head = cb->head;
+		smp_rmb();
+		for (tail = cb->tail; tail != head && emitted < budget; tail++) {
+			sbi_putc(cb->data[tail % CONSOLE_BUF_SIZE]);
+			emitted++;
+		}
+		smp_mb();
+		cb->tail = tail;
+	}
+
+	return emitted;
+}
+
+static bool console_pending(void)
+{
+	u32 i;
+	struct console_buf *cb;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	for (i = 0; i < sbi_platform_hart_count(console_plat); i++) {
+		cb = console_buf_ptr(sbi_hart_id_to_scratch(scratch, i));
+		if (cb && cb->head != cb->tail)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Emit queued output if no other HART is doing so
+ *
+ * At most CONSOLE_DRAIN_BUDGET bytes are emitted per pass, the rest is
+ * left to the next drain. A HART which failed to take the lock relies
+ * on the holder to notice its output, hence the check after unlocking.
+ */
+void sbi_console_drain(void)
+{
+	unsigned long emitted;
+
+	if (!console_buf_off)
+		return;
+
+	do {
+		if (!spin_trylock(&console_out_lock))
+			return;
+		emitted = console_drain_locked(CONSOLE_DRAIN_BUDGET);
+		spin_unlock(&console_out_lock);
+		smp_mb();
+	} while (emitted < CONSOLE_DRAIN_BUDGET && console_pending());
+}
+
+/** Emit all queued output, waiting for the console if needed */
+void sbi_console_flush(void)
 {
+	if (!console_buf_off)
+		return;
+
 	spin_lock(&console_out_lock);
+	console_drain_locked(-1UL);
+	spin_unlock(&console_out_lock);
+}
+
+static void console_buf_push(struct console_buf *cb, char ch)
+{
+	cb->data[cb->head % CONSOLE_BUF_SIZE] = ch;
+	smp_wmb();
+	cb->head++;
+}
+
+static void console_out(char ch)
+{
+	struct console_buf *cb = console_buf_ptr(sbi_scratch_thishart_ptr());
+
+	if (!cb) {
+		sbi_putc(ch);
+		return;
+	}
+
+	while (CONSOLE_BUF_SIZE <= cb->head - cb->tail)
+		sbi_console_flush();
+	console_buf_push(cb, ch);
+}
+
+void sbi_puts(const char *str)
+{
+	if (!console_buf_off) {
+		spin_lock(&console_out_lock);
+		while (*str) {
+			sbi_putc(*str);
+			str++;
+		}
+		spin_unlock(&console_out_lock);
+		return;
+	}
+
 	while (*str) {
-		sbi_putc(*str);
+		console_out(*str);
 		str++;
 	}
-	spin_unlock(&console_out_lock);
+	sbi_console_drain();
+}
+
+/**
+ * Queue bytes for output
+ *
+ * Only what fits in the buffer of the current HART is taken, waiting
+ * for the console only when the buffer is full.
+ *
+ * @return number of bytes taken
+ */
+unsigned long sbi_console_write(const char *str, unsigned long len)
+{
+	unsigned long i;
+	struct console_buf *cb = console_buf_ptr(sbi_scratch_thishart_ptr());
+
+	if (!cb) {
+		spin_lock(&console_out_lock);
+		for (i = 0; i < len; i++)
+			sbi_putc(str[i]);
+		spin_unlock(&console_out_lock);
+		return len;
+	}
+
+	if (len && CONSOLE_BUF_SIZE <= cb->head - cb->tail)
+		sbi_console_flush();
+	for (i = 0; i < len && cb->head - cb->tail < CONSOLE_BUF_SIZE; i++)
+		console_buf_push(cb, str[i]);
+	sbi_console_drain();
+
+	return i;
 }
 
 void sbi_gets(char *s, int maxwidth, char endchar)
@@ -82,7 +247,7 @@ static void printc(char **out, u32 *out_len, char ch)
 			}
 		}
 	} else {
-		sbi_putc(ch);
+		console_out(ch);
 	}
 }
 
@@ -366,11 +531,15 @@ int sbi_printf(const char *format, ...)
 	va_list args;
 	int retval;
 
-	spin_lock(&console_out_lock);
+	if (!console_buf_off)
+		spin_lock(&console_out_lock);
 	va_start(args, format);
 	retval = print(NULL, NULL, format, args);
 	va_end(args);
-	spin_unlock(&console_out_lock);
+	if (!console_buf_off)
+		spin_unlock(&console_out_lock);
+	else
+		sbi_console_drain();
 
 	return retval;
 }
@@ -384,13 +553,23 @@ int sbi_dprintf(struct sbi_scratch *scratch, const char *format, ...)
 	if (scratch->options & SBI_SCRATCH_DEBUG_PRINTS)
 		retval = print(NULL, NULL, format, args);
 	va_end(args);
+	sbi_console_drain();
 
 	return retval;
 }
 
 int sbi_console_init(struct sbi_scratch *scratch)
 {
+	int rc;
+
 	console_plat = sbi_platform_ptr(scratch);
 
-	return sbi_platform_console_init(console_plat);
+	rc = sbi_platform_console_init(console_plat);
+	if (rc)
+		return rc;
+
+	console_buf_off = sbi_scratch_alloc_cacheline_offset(
+					sizeof(struct console_buf), "CONSOLE_BUF");
+
+	return 0;
 }
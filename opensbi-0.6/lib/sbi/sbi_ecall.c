@@ -10,6 +10,8 @@
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_trap.h>
 
 #include <sbi/sbi_console.h>
@@ -28,27 +30,97 @@ u16 sbi_ecall_version_minor(void)
 
 static SBI_LIST_HEAD(ecall_exts_list);
 
+/* Extension IDs below this are looked up by direct indexing */
+#define SBI_ECALL_DIRECT_MAX		0x20
+/* Maximum number of extensions with IDs beyond the direct table */
+#define SBI_ECALL_RANGE_MAX		16
+
+static struct sbi_ecall_extension *ecall_direct[SBI_ECALL_DIRECT_MAX];
+/* Sorted by extid_start, ranges never overlap */
+static struct sbi_ecall_extension *ecall_ranges[SBI_ECALL_RANGE_MAX];
+static u32 ecall_ranges_count;
+
+#ifdef SBI_ECALL_PROFILE
+static unsigned long ecall_stats_off;
+
+struct sbi_ecall_stats *sbi_ecall_stats_ptr(struct sbi_scratch *scratch)
+{
+	if (!ecall_stats_off)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, ecall_stats_off);
+}
+
+static void sbi_ecall_stats_update(struct sbi_scratch *scratch,
+				   unsigned long cycles)
+{
+	struct sbi_ecall_stats *stats = sbi_ecall_stats_ptr(scratch);
+
+	if (!stats)
+		return;
+
+	stats->count++;
+	stats->cycles += cycles;
+	stats->last = cycles;
+}
+#else
+struct sbi_ecall_stats *sbi_ecall_stats_ptr(struct sbi_scratch *scratch)
+{
+	return NULL;
+}
+#endif
+
 struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
 {
-	struct sbi_ecall_extension *t, *ret = NULL;
+	u32 lo = 0, hi = ecall_ranges_count, mid;
+	struct sbi_ecall_extension *t;
 
-	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
-		if (t->extid_start <= extid && extid <= t->extid_end) {
-			ret = t;
-			break;
-		}
+	if (extid < SBI_ECALL_DIRECT_MAX)
+		return ecall_direct[extid];
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		t = ecall_ranges[mid];
+		if (extid < t->extid_start)
+			hi = mid;
+		else if (t->extid_end < extid)
+			lo = mid + 1;
+		else
+			return t;
 	}
 
-	return ret;
+	return NULL;
 }
 
 int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 {
+	u32 i;
+	unsigned long id;
+	struct sbi_ecall_extension *t;
+
 	if (!ext || (ext->extid_end < ext->extid_start) || !ext->handle)
 		return SBI_EINVAL;
-	if (sbi_ecall_find_extension(ext->extid_start) ||
-	    sbi_ecall_find_extension(ext->extid_end))
-		return SBI_EINVAL;
+
+	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
+		if (t->extid_start <= ext->extid_end &&
+		    ext->extid_start <= t->extid_end)
+			return SBI_EINVAL;
+	}
+
+	if (SBI_ECALL_DIRECT_MAX <= ext->extid_end) {
+		if (ecall_ranges_count == SBI_ECALL_RANGE_MAX)
+			return SBI_ENOSPC;
+
+		i = ecall_ranges_count++;
+		for (; i && ext->extid_start < ecall_ranges[i - 1]->extid_start;
+		     i--)
+			ecall_ranges[i] = ecall_ranges[i - 1];
+		ecall_ranges[i] = ext;
+	}
+
+	for (id = ext->extid_start;
+	     id < SBI_ECALL_DIRECT_MAX && id <= ext->extid_end; id++)
+		ecall_direct[id] = ext;
 
 	SBI_INIT_LIST_HEAD(&ext->head);
 	sbi_list_add_tail(&ext->head, &ecall_exts_list);
@@ -58,6 +130,8 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 
 void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 {
+	u32 i;
+	unsigned long id;
 	bool found = FALSE;
 	struct sbi_ecall_extension *t;
 
@@ -71,8 +145,23 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 		}
 	}
 
-	if (found)
-		sbi_list_del_init(&ext->head);
+	if (!found)
+		return;
+
+	for (id = ext->extid_start;
+	     id < SBI_ECALL_DIRECT_MAX && id <= ext->extid_end; id++)
+		ecall_direct[id] = NULL;
+
+	for (i = 0; i < ecall_ranges_count; i++) {
+		if (ecall_ranges[i] != ext)
+			continue;
+		ecall_ranges_count--;
+		for (; i < ecall_ranges_count; i++)
+			ecall_ranges[i] = ecall_ranges[i + 1];
+		break;
+	}
+
+	sbi_list_del_init(&ext->head);
 }
 
 int sbi_ecall_handler(u32 hartid, ulong mcause, struct sbi_trap_regs *regs,
@@ -86,6 +175,23 @@ int sbi_ecall_handler(u32 hartid, ulong mcause, struct sbi_trap_regs *regs,
 	unsigned long out_val = 0;
 	bool is_0_1_spec = 0;
 	unsigned long args[6];
+#ifdef SBI_ECALL_PROFILE
+	unsigned long start_cycle = csr_read(CSR_MCYCLE);
+#endif
+
+	/* Penglai calls multiplexed on BASE by older enclave drivers */
+	if (extension_id == SBI_EXT_BASE &&
+	    SBI_PENGLAI_LEGACY_FID_MIN <= func_id &&
+	    func_id <= SBI_PENGLAI_LEGACY_FID_MAX)
+		extension_id = SBI_EXT_PENGLAI;
+
+	if (extension_id == SBI_EXT_PENGLAI) {
+		sbi_trace(scratch, SBI_TRACE_ENCLAVE, func_id, regs->a0, 0);
+		if (sbi_ecall_penglai_switch(regs))
+			return 0;
+	}
+
+	sbi_trace(scratch, SBI_TRACE_ECALL_ENTER, 0, extension_id, func_id);
 
 	args[0] = regs->a0;
 	args[1] = regs->a1;
@@ -94,15 +200,6 @@ int sbi_ecall_handler(u32 hartid, ulong mcause, struct sbi_trap_regs *regs,
 	args[4] = regs->a4;
 	args[5] = regs->a5;
 
-	if (extension_id == SBI_EXT_BASE && func_id>80){
-		/* FIXME(DD): hacking, when extension id is base, put regs into last args
-		 * * currently this reg will not be used by any base functions
-		 */
-		sbi_printf("[PenglaiMonitor@%s] begin with mepc: 0x%x\n", __func__, regs->mepc);
-		args[5] = (unsigned long) regs;
-		regs->mepc += 4;
-	}
-
 	ext = sbi_ecall_find_extension(extension_id);
 	if (ext && ext->handle) {
 		ret = ext->handle(scratch, extension_id, func_id,
@@ -117,11 +214,6 @@ int sbi_ecall_handler(u32 hartid, ulong mcause, struct sbi_trap_regs *regs,
 	if (ret == SBI_ETRAP) {
 		trap.epc = regs->mepc;
 		sbi_trap_redirect(regs, &trap, scratch);
-	} else if (extension_id == SBI_EXT_BASE && func_id>80){
-		regs->a0 = ret;
-		if (!is_0_1_spec)
-			regs->a1 = out_val;
-
 	} else {
 		/* This function should return non-zero value only in case of
 		 * fatal error. However, there is no good way to distinguish
@@ -135,13 +227,12 @@ int sbi_ecall_handler(u32 hartid, ulong mcause, struct sbi_trap_regs *regs,
 		if (!is_0_1_spec)
 			regs->a1 = out_val;
 	}
-	if (extension_id == SBI_EXT_BASE && func_id>80){
-		/* FIXME(DD): hacking, when extension id is base, put regs into last args
-		 * * currently this reg will not be used by any base functions
-		 */
-		sbi_printf("[PenglaiMonitor@%s] end with mepc: 0x%x\n", __func__, regs->mepc);
-	}
 
+	sbi_trace(scratch, SBI_TRACE_ECALL_EXIT, 0, extension_id, ret);
+
+#ifdef SBI_ECALL_PROFILE
+	sbi_ecall_stats_update(scratch, csr_read(CSR_MCYCLE) - start_cycle);
+#endif
 
 	return 0;
 }
@@ -150,7 +241,13 @@ int sbi_ecall_init(void)
 {
 	int ret;
 
-	/* The order of below registrations is performance optimized */
+#ifdef SBI_ECALL_PROFILE
+	ecall_stats_off = sbi_scratch_alloc_offset(sizeof(struct sbi_ecall_stats),
+						   "ECALL_STATS");
+	if (!ecall_stats_off)
+		return SBI_ENOMEM;
+#endif
+
 	ret = sbi_ecall_register_extension(&ecall_time);
 	if (ret)
 		return ret;
@@ -158,15 +255,30 @@ int sbi_ecall_init(void)
 	if (ret)
 		return ret;
 	ret = sbi_ecall_register_extension(&ecall_ipi);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_dbcn);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_hsm);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_pmu);
 	if (ret)
 		return ret;
 	ret = sbi_ecall_register_extension(&ecall_base);
 	if (ret)
 		return ret;
 	ret = sbi_ecall_register_extension(&ecall_legacy);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_penglai);
 	if (ret)
 		return ret;
 	ret = sbi_ecall_register_extension(&ecall_vendor);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_register_extension(&ecall_profile);
 	if (ret)
 		return ret;
 
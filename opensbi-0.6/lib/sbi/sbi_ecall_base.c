@@ -35,14 +35,6 @@ static int sbi_ecall_base_probe(struct sbi_scratch *scratch,
 	return 0;
 }
 
-/* Declare Penglai SM handlers here*/
-extern uintptr_t sm_mm_init(uintptr_t paddr, unsigned long size);
-extern uintptr_t sm_mm_extend(uintptr_t paddr, unsigned long size);
-extern uintptr_t sm_alloc_enclave_mem(uintptr_t mm_alloc_arg);
-extern uintptr_t sm_create_enclave(uintptr_t enclave_sbi_param);
-extern uintptr_t sm_run_enclave(uintptr_t* regs, unsigned long eid);
-extern uintptr_t sm_exit_enclave(uintptr_t* regs, unsigned long retval);
-
 static int sbi_ecall_base_handler(struct sbi_scratch *scratch,
 				  unsigned long extid, unsigned long funcid,
 				  unsigned long *args, unsigned long *out_val,
@@ -76,27 +68,6 @@ static int sbi_ecall_base_handler(struct sbi_scratch *scratch,
 	case SBI_EXT_BASE_PROBE_EXT:
 		ret = sbi_ecall_base_probe(scratch, args[0], out_val);
 		break;
-	case SBI_MM_INIT:
-	  ret = sm_mm_init(args[0], args[1]);
-	  //ret = 0;
-	  break;
-	case SBI_MEMORY_EXTEND:
-	  ret = sm_mm_extend(args[0], args[1]);
-	  break;
-	case SBI_ALLOC_ENCLAVE_MM:
-	  ret = sm_alloc_enclave_mem(args[0]);
-	  break;
-	case SBI_CREATE_ENCLAVE:
-	  ret = sm_create_enclave(args[0]);
-	  break;
-	case SBI_RUN_ENCLAVE:
-	  //args5 is regs
-	  ret = sm_run_enclave((uintptr_t *)args[5], args[0]);
-	  break;
-	case SBI_EXIT_ENCLAVE:
-	  //args5 is regs
-	  ret = sm_exit_enclave((uintptr_t *)args[5], args[0]);
-	  break;
 	default:
 		ret = SBI_ENOTSUPP;
 	}
@@ -0,0 +1,133 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_penglai_sm.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_unpriv.h>
+
+/* Bytes copied from S-mode at a time by CONSOLE_WRITE */
+#define DBCN_WRITE_CHUNK	64
+
+/* S-mode buffers are physical and must stay clear of protected memory */
+static bool dbcn_addr_valid(struct sbi_scratch *scratch, unsigned long base,
+			    unsigned long len)
+{
+	if (base + len < base)
+		return FALSE;
+	if (base < scratch->fw_start + scratch->fw_size &&
+	    scratch->fw_start < base + len)
+		return FALSE;
+	if (check_mem_overlap(base, len))
+		return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * The buffer is accessed through MPRV with address translation off, so
+ * PMP applies the S-mode permissions to the physical address and a bad
+ * address traps back to S-mode instead of faulting in M-mode.
+ */
+static int dbcn_write(struct sbi_scratch *scratch, unsigned long base,
+		      unsigned long len, unsigned long *out_val,
+		      struct sbi_trap_info *trap)
+{
+	char buf[DBCN_WRITE_CHUNK];
+	unsigned long i, n, done = 0;
+	unsigned long satp = csr_swap(CSR_SATP, 0);
+
+	while (done < len) {
+		n = len - done;
+		if (DBCN_WRITE_CHUNK < n)
+			n = DBCN_WRITE_CHUNK;
+
+		for (i = 0; i < n; i++) {
+			buf[i] = sbi_load_u8((const u8 *)(base + done + i),
+					     scratch, trap);
+			if (trap->cause)
+				goto out;
+		}
+
+		i = sbi_console_write(buf, n);
+		done += i;
+		if (i < n)
+			break;
+	}
+
+out:
+	csr_write(CSR_SATP, satp);
+	*out_val = done;
+
+	return trap->cause ? SBI_ETRAP : 0;
+}
+
+static int dbcn_read(struct sbi_scratch *scratch, unsigned long base,
+		     unsigned long len, unsigned long *out_val,
+		     struct sbi_trap_info *trap)
+{
+	int c;
+	unsigned long i;
+	unsigned long satp = csr_swap(CSR_SATP, 0);
+
+	for (i = 0; i < len; i++) {
+		/* Probe the byte first so that no input is lost to a trap */
+		sbi_store_u8((u8 *)(base + i), 0, scratch, trap);
+		if (trap->cause)
+			break;
+		c = sbi_getc();
+		if (c < 0)
+			break;
+		sbi_store_u8((u8 *)(base + i), c, scratch, trap);
+	}
+
+	csr_write(CSR_SATP, satp);
+	*out_val = i;
+
+	return trap->cause ? SBI_ETRAP : 0;
+}
+
+static int sbi_ecall_dbcn_handler(struct sbi_scratch *scratch,
+				  unsigned long extid, unsigned long funcid,
+				  unsigned long *args, unsigned long *out_val,
+				  struct sbi_trap_info *out_trap)
+{
+	char ch;
+	unsigned long len = args[0], base = args[1];
+
+	switch (funcid) {
+	case SBI_EXT_DBCN_CONSOLE_WRITE:
+	case SBI_EXT_DBCN_CONSOLE_READ:
+		/* Upper bits of the physical address, only used on RV32 */
+		if (__riscv_xlen == 32 && args[2])
+			return SBI_INVALID_ADDR;
+		if (!dbcn_addr_valid(scratch, base, len))
+			return SBI_INVALID_ADDR;
+
+		if (funcid == SBI_EXT_DBCN_CONSOLE_WRITE)
+			return dbcn_write(scratch, base, len, out_val,
+					  out_trap);
+		return dbcn_read(scratch, base, len, out_val, out_trap);
+	case SBI_EXT_DBCN_CONSOLE_WRITE_BYTE:
+		ch = args[0];
+		sbi_console_write(&ch, 1);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_dbcn = {
+	.extid_start = SBI_EXT_DBCN,
+	.extid_end = SBI_EXT_DBCN,
+	.handle = sbi_ecall_dbcn_handler,
+};
@@ -13,6 +13,7 @@
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_penglai_hart.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
@@ -24,7 +25,7 @@ static int sbi_load_hart_mask_unpriv(struct sbi_scratch *scratch,
 				     ulong *pmask, ulong *hmask,
 				     struct sbi_trap_info *uptrap)
 {
-	ulong mask = 0;
+	ulong mask = 0, base = 0;
 
 	if (pmask) {
 		mask = sbi_load_ulong(pmask, scratch, uptrap);
@@ -33,6 +34,8 @@ static int sbi_load_hart_mask_unpriv(struct sbi_scratch *scratch,
 	} else {
 		mask = sbi_hart_available_mask();
 	}
+	/* The host may not reach HARTs it gave to an enclave */
+	sbi_penglai_hart_filter(&mask, &base);
 	*hmask = mask;
 	return 0;
 }
@@ -46,6 +49,7 @@ static int sbi_ecall_legacy_handler(struct sbi_scratch *scratch,
 	struct sbi_tlb_info tlb_info;
 	u32 source_hart = sbi_current_hartid();
 	ulong hmask = 0;
+	char ch;
 
 	switch (extid) {
 	case SBI_EXT_0_1_SET_TIMER:
@@ -57,7 +61,8 @@ static int sbi_ecall_legacy_handler(struct sbi_scratch *scratch,
 #endif
 		break;
 	case SBI_EXT_0_1_CONSOLE_PUTCHAR:
-		sbi_putc(args[0]);
+		ch = args[0];
+		sbi_console_write(&ch, 1);
 		break;
 	case SBI_EXT_0_1_CONSOLE_GETCHAR:
 		ret = sbi_getc();
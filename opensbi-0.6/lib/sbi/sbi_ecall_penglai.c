@@ -0,0 +1,249 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_penglai_ctx.h>
+#include <sbi/sbi_penglai_hart.h>
+#include <sbi/sbi_penglai_sm.h>
+#include <sbi/sbi_penglai_shm.h>
+#include <sbi/sbi_penglai_tmpl.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_secmem.h>
+#include <sbi/sbi_trace.h>
+#include <sbi/sbi_trap.h>
+
+#ifdef SBI_PENGLAI_TRACE
+#define penglai_trace(fmt, ...)	\
+	sbi_printf("[PenglaiMonitor@%s] " fmt, __func__, ##__VA_ARGS__)
+#else
+#define penglai_trace(fmt, ...)
+#endif
+
+/* Out of secure memory, see sm/sm.h */
+#define PENGLAI_ENCLAVE_NO_MEM		-2
+
+/* Bit of a1 asking the host to donate more memory in the background */
+#define PENGLAI_MEMORY_LOW		0x1
+
+/* Penglai SM entry points, see sm/sm.c */
+extern uintptr_t sm_alloc_enclave_mem(uintptr_t mm_alloc_arg);
+extern uintptr_t sm_create_enclave(uintptr_t enclave_sbi_param);
+extern uintptr_t sm_run_enclave(uintptr_t* regs, unsigned long eid);
+extern uintptr_t sm_resume_enclave(uintptr_t* regs, unsigned long eid);
+extern uintptr_t sm_enclave_ocall(uintptr_t* regs, uintptr_t ocall_id,
+				  uintptr_t arg0, uintptr_t arg1);
+extern uintptr_t sm_exit_enclave(uintptr_t* regs, unsigned long retval);
+extern uintptr_t sm_enclave_clone(unsigned long tmpl_id,
+				  const struct sbi_penglai_tmpl_image *image,
+				  uintptr_t enclave_sbi_param);
+
+/**
+ * Fast path for enclave world switches
+ *
+ * These calls save and rewrite the trap frame in place, so they take the
+ * trap registers directly and skip the generic dispatch. The mepc is
+ * advanced before the switch so that it is saved past the ecall. Each
+ * switch is timed into the per-HART PENGLAI_CTX statistics.
+ *
+ * Returns TRUE if the call was handled here.
+ */
+bool sbi_ecall_penglai_switch(struct sbi_trap_regs *regs)
+{
+	u32 kind;
+	uintptr_t ret;
+	unsigned long regs_addr = (unsigned long)regs;
+	uintptr_t *r = (uintptr_t *)regs_addr;
+	unsigned long start = sbi_penglai_switch_begin();
+
+	switch (regs->a6) {
+	case SBI_RUN_ENCLAVE:
+		kind = SBI_PENGLAI_SWITCH_RUN;
+		regs->mepc += 4;
+		ret = sm_run_enclave(r, regs->a0);
+		break;
+	case SBI_RESUME_ENCLAVE:
+		kind = SBI_PENGLAI_SWITCH_RESUME;
+		regs->mepc += 4;
+		ret = sm_resume_enclave(r, regs->a0);
+		break;
+	case SBI_ENCLAVE_OCALL:
+		kind = SBI_PENGLAI_SWITCH_OCALL;
+		regs->mepc += 4;
+		ret = sm_enclave_ocall(r, regs->a0, regs->a1, regs->a2);
+		break;
+	case SBI_EXIT_ENCLAVE:
+		kind = SBI_PENGLAI_SWITCH_EXIT;
+		regs->mepc += 4;
+		ret = sm_exit_enclave(r, regs->a0);
+		break;
+	default:
+		return FALSE;
+	}
+
+	regs->a0 = ret;
+	regs->a1 = 0;
+
+	sbi_penglai_switch_end(sbi_scratch_thishart_ptr(), kind, start);
+
+	return TRUE;
+}
+
+static int sbi_ecall_penglai_sm_extend(unsigned long base, unsigned long size)
+{
+	return sm_mm_extend(base, size);
+}
+
+/* Shared regions stay host memory, the SM must not claim them */
+static int sbi_ecall_penglai_mm_extend(unsigned long base, unsigned long size)
+{
+	return sbi_penglai_shm_exclude(base, size,
+				       sbi_ecall_penglai_sm_extend);
+}
+
+/* Move one chunk of the reserve into the SM secure memory */
+static int sbi_ecall_penglai_refill(void)
+{
+	unsigned long base = sbi_secmem_take(SBI_SECMEM_CHUNK_SIZE);
+
+	if (!base)
+		return SBI_ENOMEM;
+
+	if (sm_mm_extend(base, SBI_SECMEM_CHUNK_SIZE)) {
+		/* Rejected by the SM, keep the chunk for the host */
+		sbi_secmem_donate(base, SBI_SECMEM_CHUNK_SIZE);
+		return SBI_EFAIL;
+	}
+
+	return 0;
+}
+
+/*
+ * Refill the SM after a call failed for lack of memory. Returns TRUE if
+ * the call should be retried. Otherwise *ret is left as the SM error if
+ * the reserve is empty, so the host donates more, or is set to the
+ * refill error.
+ */
+static bool sbi_ecall_penglai_retry(int *ret)
+{
+	int rc;
+
+	if (*ret != PENGLAI_ENCLAVE_NO_MEM)
+		return FALSE;
+
+	rc = sbi_ecall_penglai_refill();
+	if (rc && rc != SBI_ENOMEM)
+		*ret = rc;
+
+	return !rc;
+}
+
+/*
+ * Create an enclave sharing the pages and measurement of a template.
+ * Only the page tables and the pages written later are allocated, so
+ * this does not depend on the image size. The template reference is
+ * dropped by the SM when the clone is destroyed.
+ */
+static int sbi_ecall_penglai_clone(unsigned long tmpl_id,
+				   uintptr_t enclave_sbi_param)
+{
+	int ret;
+	const struct sbi_penglai_tmpl_image *image;
+
+	ret = sbi_penglai_tmpl_get(tmpl_id, &image);
+	if (ret)
+		return ret;
+
+	do {
+		ret = sm_enclave_clone(tmpl_id, image, enclave_sbi_param);
+	} while (sbi_ecall_penglai_retry(&ret));
+	if (ret)
+		sbi_penglai_tmpl_put(tmpl_id);
+
+	return ret;
+}
+
+static int sbi_ecall_penglai_handler(struct sbi_scratch *scratch,
+				     unsigned long extid, unsigned long funcid,
+				     unsigned long *args, unsigned long *out_val,
+				     struct sbi_trap_info *out_trap)
+{
+	int ret;
+
+	penglai_trace("begin funcid %ld\n", funcid);
+
+	switch (funcid) {
+	case SBI_MM_INIT:
+		ret = sm_mm_init(args[0], args[1]);
+		break;
+	case SBI_MEMORY_EXTEND:
+		/* Donations that can extend the reserve are kept there */
+		ret = sbi_secmem_donate(args[0], args[1]);
+		if (ret == SBI_EINVAL)
+			ret = sbi_trace_exclude(scratch, args[0], args[1],
+						sbi_ecall_penglai_mm_extend);
+		break;
+	case SBI_MEMORY_RECLAIM:
+		/* The SM has no reclaim call, only the reserve gives back */
+		ret = sbi_secmem_reclaim(args[0], out_val);
+		break;
+	case SBI_ALLOC_ENCLAVE_MM:
+		do {
+			ret = sm_alloc_enclave_mem(args[0]);
+		} while (sbi_ecall_penglai_retry(&ret));
+		if (sbi_secmem_below_low_watermark())
+			*out_val |= PENGLAI_MEMORY_LOW;
+		break;
+	case SBI_CREATE_ENCLAVE:
+		do {
+			ret = sm_create_enclave(args[0]);
+		} while (sbi_ecall_penglai_retry(&ret));
+		if (sbi_secmem_below_low_watermark())
+			*out_val |= PENGLAI_MEMORY_LOW;
+		break;
+	case SBI_TEMPLATE_CREATE:
+		ret = sbi_penglai_tmpl_create(args[0], out_val);
+		break;
+	case SBI_TEMPLATE_CLONE:
+		ret = sbi_ecall_penglai_clone(args[0], args[1]);
+		if (sbi_secmem_below_low_watermark())
+			*out_val |= PENGLAI_MEMORY_LOW;
+		break;
+	case SBI_TEMPLATE_DESTROY:
+		ret = sbi_penglai_tmpl_destroy(args[0]);
+		break;
+	case SBI_SHM_CREATE:
+		ret = sbi_penglai_shm_create(args[0], args[1], args[2], out_val);
+		break;
+	case SBI_SHM_GRANT:
+		ret = sbi_penglai_shm_grant(args[0], args[1], args[2], out_val);
+		break;
+	case SBI_SHM_REVOKE:
+		ret = sbi_penglai_shm_revoke(args[0], args[1]);
+		break;
+	case SBI_SHM_DESTROY:
+		ret = sbi_penglai_shm_destroy(args[0]);
+		break;
+	case SBI_HART_ASSIGN:
+		ret = sbi_penglai_hart_assign(scratch, args[0], args[1]);
+		break;
+	case SBI_HART_RELEASE:
+		ret = sbi_penglai_hart_release(scratch, args[0]);
+		break;
+	default:
+		ret = SBI_ENOTSUPP;
+	}
+
+	penglai_trace("end funcid %ld ret %d\n", funcid, ret);
+
+	return ret;
+}
+
+struct sbi_ecall_extension ecall_penglai = {
+	.extid_start = SBI_EXT_PENGLAI,
+	.extid_end = SBI_EXT_PENGLAI,
+	.handle = sbi_ecall_penglai_handler,
+};
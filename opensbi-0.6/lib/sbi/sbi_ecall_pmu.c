@@ -0,0 +1,51 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
+
+/* 64-bit values take a register pair on RV32, low half first */
+static u64 pmu_arg_u64(unsigned long *args, int i)
+{
+#if __riscv_xlen == 32
+	return ((u64)args[i + 1] << 32) | args[i];
+#else
+	return args[i];
+#endif
+}
+
+static int sbi_ecall_pmu_handler(struct sbi_scratch *scratch,
+				 unsigned long extid, unsigned long funcid,
+				 unsigned long *args, unsigned long *out_val,
+				 struct sbi_trap_info *out_trap)
+{
+	switch (funcid) {
+	case SBI_EXT_PMU_NUM_COUNTERS:
+		*out_val = sbi_pmu_num_counters();
+		return 0;
+	case SBI_EXT_PMU_COUNTER_GET_INFO:
+		return sbi_pmu_counter_info(args[0], out_val);
+	case SBI_EXT_PMU_COUNTER_CFG_MATCH:
+		return sbi_pmu_counter_cfg_match(scratch, args[0], args[1],
+						 args[2], args[3],
+						 pmu_arg_u64(args, 4), out_val);
+	case SBI_EXT_PMU_COUNTER_START:
+		return sbi_pmu_counter_start(scratch, args[0], args[1], args[2],
+					     pmu_arg_u64(args, 3));
+	case SBI_EXT_PMU_COUNTER_STOP:
+		return sbi_pmu_counter_stop(scratch, args[0], args[1], args[2]);
+	default:
+		return SBI_ENOTSUPP;
+	}
+}
+
+struct sbi_ecall_extension ecall_pmu = {
+	.extid_start = SBI_EXT_PMU,
+	.extid_end = SBI_EXT_PMU,
+	.handle = sbi_ecall_pmu_handler,
+};
@@ -0,0 +1,166 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 IPADS, Shanghai Jiao Tong University.
+ *
+ * Authors:
+ *   Penglai Enclave developers
+ */
+
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_penglai_ctx.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trace.h>
+
+/*
+ * Misaligned trap statistics of the current HART. PC and HITS take the
+ * slot index in a0, slots with zero hits are unused.
+ */
+static int sbi_ecall_profile_misaligned(struct sbi_scratch *scratch,
+					unsigned long funcid,
+					unsigned long *args,
+					unsigned long *out_val)
+{
+	struct sbi_misaligned_stats *stats = sbi_misaligned_stats_ptr(scratch);
+
+	if (!stats)
+		return SBI_ENOTSUPP;
+
+	switch (funcid) {
+	case SBI_EXT_PROFILE_MISALIGNED_COUNT:
+		*out_val = stats->count;
+		break;
+	case SBI_EXT_PROFILE_MISALIGNED_PC:
+		if (SBI_MISALIGNED_STATS_SLOTS <= args[0])
+			return SBI_EINVAL;
+		*out_val = stats->pc[args[0]];
+		break;
+	case SBI_EXT_PROFILE_MISALIGNED_HITS:
+		if (SBI_MISALIGNED_STATS_SLOTS <= args[0])
+			return SBI_EINVAL;
+		*out_val = stats->hits[args[0]];
+		break;
+	case SBI_EXT_PROFILE_MISALIGNED_RESET:
+		sbi_memset(stats, 0, sizeof(*stats));
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+/*
+ * Enclave world switch statistics of the current HART. COUNT, CYCLES and
+ * MAX take the SBI_PENGLAI_SWITCH_xxx kind in a0, FP takes the
+ * SBI_PENGLAI_FP_xxx counter in a0.
+ */
+static int sbi_ecall_profile_switch(struct sbi_scratch *scratch,
+				    unsigned long funcid,
+				    unsigned long *args,
+				    unsigned long *out_val)
+{
+	struct sbi_penglai_ctx_stats *stats = sbi_penglai_ctx_stats_ptr(scratch);
+
+	if (!stats)
+		return SBI_ENOTSUPP;
+
+	if (funcid == SBI_EXT_PROFILE_SWITCH_RESET) {
+		sbi_memset(stats, 0, sizeof(*stats));
+		return 0;
+	}
+
+	if (funcid == SBI_EXT_PROFILE_SWITCH_FP) {
+		if (SBI_PENGLAI_FP_COUNTERS <= args[0])
+			return SBI_EINVAL;
+		*out_val = stats->fp[args[0]];
+		return 0;
+	}
+
+	if (SBI_PENGLAI_SWITCH_KINDS <= args[0])
+		return SBI_EINVAL;
+
+	switch (funcid) {
+	case SBI_EXT_PROFILE_SWITCH_COUNT:
+		*out_val = stats->count[args[0]];
+		break;
+	case SBI_EXT_PROFILE_SWITCH_CYCLES:
+		*out_val = stats->cycles[args[0]];
+		break;
+	case SBI_EXT_PROFILE_SWITCH_MAX:
+		*out_val = stats->max[args[0]];
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+/*
+ * The NOP function lets S-mode time a bare ecall round trip with rdcycle.
+ * The statistics functions report the mcycle spent in sbi_ecall_handler()
+ * on the current HART. Reading ECALL_LAST right after a NOP gives the
+ * M-mode cost of that NOP since the current ecall is not accounted yet.
+ * TRACE_START hands the current HART a trace buffer, with its physical
+ * address in a0, its size in a1 and the SBI_TRACE_xxx event mask in a2.
+ */
+static int sbi_ecall_profile_handler(struct sbi_scratch *scratch,
+				     unsigned long extid, unsigned long funcid,
+				     unsigned long *args, unsigned long *out_val,
+				     struct sbi_trap_info *out_trap)
+{
+	struct sbi_ecall_stats *stats;
+
+	switch (funcid) {
+	case SBI_EXT_PROFILE_NOP:
+		return 0;
+	case SBI_EXT_PROFILE_TRACE_START:
+		return sbi_trace_start(scratch, args[0], args[1], args[2]);
+	case SBI_EXT_PROFILE_TRACE_STOP:
+		sbi_trace_stop(scratch);
+		return 0;
+	}
+
+	if (SBI_EXT_PROFILE_MISALIGNED_COUNT <= funcid &&
+	    funcid <= SBI_EXT_PROFILE_MISALIGNED_RESET)
+		return sbi_ecall_profile_misaligned(scratch, funcid,
+						    args, out_val);
+	if (SBI_EXT_PROFILE_SWITCH_COUNT <= funcid &&
+	    funcid <= SBI_EXT_PROFILE_SWITCH_RESET)
+		return sbi_ecall_profile_switch(scratch, funcid, args, out_val);
+
+	stats = sbi_ecall_stats_ptr(scratch);
+	if (!stats)
+		return SBI_ENOTSUPP;
+
+	switch (funcid) {
+	case SBI_EXT_PROFILE_ECALL_COUNT:
+		*out_val = stats->count;
+		break;
+	case SBI_EXT_PROFILE_ECALL_CYCLES:
+		*out_val = stats->cycles;
+		break;
+	case SBI_EXT_PROFILE_ECALL_LAST:
+		*out_val = stats->last;
+		break;
+	case SBI_EXT_PROFILE_RESET:
+		stats->count = 0;
+		stats->cycles = 0;
+		stats->last = 0;
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_profile = {
+	.extid_start = SBI_EXT_PROFILE,
+	.extid_end = SBI_EXT_PROFILE,
+	.handle = sbi_ecall_profile_handler,
+};
@@ -13,8 +13,12 @@
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_penglai_hart.h>
+#include <sbi/sbi_platform.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_unpriv.h>
 #include <sbi/riscv_asm.h>
 
 static int sbi_ecall_time_handler(struct sbi_scratch *scratch,
@@ -43,15 +47,108 @@ struct sbi_ecall_extension ecall_time = {
 	.handle = sbi_ecall_time_handler,
 };
 
+/*
+ * Call fn for the hart mask in args[0] and args[1], with the HARTs the
+ * host gave to an enclave left out. A hart mask passed by address is
+ * handed to fn one word at a time, as the scalar hmask/hbase pair
+ * expected by sbi_ipi_send_many(), so that S-mode needs one call for
+ * any set of HARTs. Only the words covering the platform HARTs are read
+ * and empty words are skipped. Stops at the first error.
+ */
+static int sbi_ecall_for_each_hart_mask(struct sbi_scratch *scratch,
+					unsigned long *args,
+					struct sbi_trap_info *out_trap,
+					int (*fn)(struct sbi_scratch *scratch,
+						  ulong hmask, ulong hbase,
+						  void *priv),
+					void *priv)
+{
+	int ret;
+	ulong i, hmask, hbase;
+	const ulong *pmask = (const ulong *)args[0];
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (args[1] != SBI_HART_MASK_BASE_SHMEM) {
+		hmask = args[0];
+		hbase = args[1];
+		sbi_penglai_hart_filter(&hmask, &hbase);
+		return fn(scratch, hmask, hbase, priv);
+	}
+
+	for (i = 0; i * BITS_PER_LONG < sbi_platform_hart_count(plat); i++) {
+		hmask = sbi_load_ulong(&pmask[i], scratch, out_trap);
+		if (out_trap->cause)
+			return SBI_ETRAP;
+		if (!hmask)
+			continue;
+
+		hbase = i * BITS_PER_LONG;
+		sbi_penglai_hart_filter(&hmask, &hbase);
+		ret = fn(scratch, hmask, hbase, priv);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+struct sbi_ecall_rfence_req {
+	struct sbi_tlb_info *tlb_info;
+	/** Where to return the ticket of an async request, NULL if sync */
+	unsigned long *ticket;
+};
+
+/*
+ * Async requests track their targets in a single word, so there is
+ * only ever one chunk and one ticket, see sbi_tlb_request_async().
+ */
+static int sbi_ecall_rfence_send(struct sbi_scratch *scratch, ulong hmask,
+				 ulong hbase, void *priv)
+{
+	struct sbi_ecall_rfence_req *req = priv;
+
+	if (req->ticket)
+		return sbi_tlb_request_async(scratch, hmask, hbase,
+					     req->tlb_info, req->ticket);
+
+	return sbi_tlb_request(scratch, hmask, hbase, req->tlb_info);
+}
+
+static int sbi_ecall_rfence_request(struct sbi_scratch *scratch,
+				    unsigned long *args, bool async,
+				    struct sbi_tlb_info *tlb_info,
+				    unsigned long *out_val,
+				    struct sbi_trap_info *out_trap)
+{
+	struct sbi_ecall_rfence_req req = {
+		.tlb_info = tlb_info,
+		.ticket = async ? out_val : NULL,
+	};
+
+	return sbi_ecall_for_each_hart_mask(scratch, args, out_trap,
+					    sbi_ecall_rfence_send, &req);
+}
+
 static int sbi_ecall_rfence_handler(struct sbi_scratch *scratch,
 				    unsigned long extid, unsigned long funcid,
 				    unsigned long *args, unsigned long *out_val,
 				    struct sbi_trap_info *out_trap)
 {
 	int ret = 0;
+	bool async = FALSE;
 	struct sbi_tlb_info tlb_info;
 	u32 source_hart = sbi_current_hartid();
 
+	if (funcid == SBI_EXT_RFENCE_TICKET_POLL ||
+	    funcid == SBI_EXT_RFENCE_TICKET_WAIT)
+		return sbi_tlb_ticket_poll(scratch, args[0],
+				funcid == SBI_EXT_RFENCE_TICKET_WAIT, out_val);
+
+	if (funcid & SBI_EXT_RFENCE_ASYNC_FLAG) {
+		async = TRUE;
+		funcid &= ~SBI_EXT_RFENCE_ASYNC_FLAG;
+	}
+
 	if (funcid >= SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA &&
 	    funcid <= SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID)
 		if (!misa_extension('H'))
@@ -63,14 +160,16 @@ static int sbi_ecall_rfence_handler(struct sbi_scratch *scratch,
 		tlb_info.size  = 0;
 		tlb_info.type  = SBI_ITLB_FLUSH;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA:
 		tlb_info.start = (unsigned long)args[2];
 		tlb_info.size  = (unsigned long)args[3];
 		tlb_info.type  = SBI_TLB_FLUSH_GVMA;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID:
 		tlb_info.start = (unsigned long)args[2];
@@ -78,14 +177,16 @@ static int sbi_ecall_rfence_handler(struct sbi_scratch *scratch,
 		tlb_info.asid  = (unsigned long)args[4];
 		tlb_info.type  = SBI_TLB_FLUSH_GVMA_VMID;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA:
 		tlb_info.start = (unsigned long)args[2];
 		tlb_info.size  = (unsigned long)args[3];
 		tlb_info.type  = SBI_TLB_FLUSH_VVMA;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID:
 		tlb_info.start = (unsigned long)args[2];
@@ -93,14 +194,16 @@ static int sbi_ecall_rfence_handler(struct sbi_scratch *scratch,
 		tlb_info.asid  = (unsigned long)args[4];
 		tlb_info.type  = SBI_TLB_FLUSH_VVMA_ASID;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
 		tlb_info.start = (unsigned long)args[2];
 		tlb_info.size  = (unsigned long)args[3];
 		tlb_info.type  = SBI_TLB_FLUSH_VMA;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
 		tlb_info.start = (unsigned long)args[2];
@@ -108,7 +211,8 @@ static int sbi_ecall_rfence_handler(struct sbi_scratch *scratch,
 		tlb_info.asid  = (unsigned long)args[4];
 		tlb_info.type  = SBI_TLB_FLUSH_VMA_ASID;
 		tlb_info.shart_mask = 1UL << source_hart;
-		ret = sbi_tlb_request(scratch, args[0], args[1], &tlb_info);
+		ret = sbi_ecall_rfence_request(scratch, args, async,
+					       &tlb_info, out_val, out_trap);
 		break;
 
 	default:
@@ -124,19 +228,22 @@ struct sbi_ecall_extension ecall_rfence = {
 	.handle = sbi_ecall_rfence_handler,
 };
 
+static int sbi_ecall_ipi_send(struct sbi_scratch *scratch, ulong hmask,
+			      ulong hbase, void *priv)
+{
+	return sbi_ipi_send_smode(scratch, hmask, hbase);
+}
+
 static int sbi_ecall_ipi_handler(struct sbi_scratch *scratch,
 				 unsigned long extid, unsigned long funcid,
 				 unsigned long *args, unsigned long *out_val,
 				 struct sbi_trap_info *out_trap)
 {
-	int ret = 0;
-
-	if (funcid == SBI_EXT_IPI_SEND_IPI)
-		ret = sbi_ipi_send_smode(scratch, args[0], args[1]);
-	else
-		ret = SBI_ENOTSUPP;
+	if (funcid != SBI_EXT_IPI_SEND_IPI)
+		return SBI_ENOTSUPP;
 
-	return ret;
+	return sbi_ecall_for_each_hart_mask(scratch, args, out_trap,
+					    sbi_ecall_ipi_send, NULL);
 }
 
 struct sbi_ecall_extension ecall_ipi = {
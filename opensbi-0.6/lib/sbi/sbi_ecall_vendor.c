@@ -33,7 +33,7 @@ static int sbi_ecall_vendor_handler(struct sbi_scratch *scratch,
 }
 
 struct sbi_ecall_extension ecall_vendor = {
-	.extid_start = SBI_EXT_VENDOR_START,
+	.extid_start = SBI_EXT_PENGLAI + 1,
 	.extid_end = SBI_EXT_VENDOR_END,
 	.probe = sbi_ecall_vendor_probe,
 	.handle = sbi_ecall_vendor_handler,
@@ -17,6 +17,8 @@
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmp.h>
+#include <sbi/sbi_secmem.h>
 
 /**
  * Return HART ID of the caller.
@@ -166,32 +168,60 @@ void sbi_hart_pmp_dump(struct sbi_scratch *scratch)
 	}
 }
 
-static int pmp_init(struct sbi_scratch *scratch, u32 hartid)
+static int pmp_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 {
+	int rc;
 	u32 i, count;
 	unsigned long fw_start, fw_size_log2;
 	ulong prot, addr, log2size;
+	struct sbi_pmp_layout layout;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (!sbi_platform_has_pmp(plat))
 		return 0;
 
+	rc = sbi_pmp_init(scratch, cold_boot);
+	if (rc)
+		return rc;
+
 	fw_size_log2 = log2roundup(scratch->fw_size);
 	fw_start     = scratch->fw_start & ~((1UL << fw_size_log2) - 1UL);
 
-	pmp_set(0, 0, fw_start, fw_size_log2);
+	sbi_pmp_layout_init(&layout);
+	rc = sbi_pmp_layout_add_napot(&layout, 0, fw_start, fw_size_log2);
+	if (rc)
+		return rc;
+
+	/* The secure memory reserve takes precedence over platform regions */
+	rc = sbi_secmem_pmp_layout(&layout);
+	if (rc)
+		return rc;
 
 	count = sbi_platform_pmp_region_count(plat, hartid);
-	if ((PMP_COUNT - 1) < count)
-		count = (PMP_COUNT - 1);
+	if ((PMP_COUNT - layout.count) < count)
+		count = (PMP_COUNT - layout.count);
 
 	for (i = 0; i < count; i++) {
 		if (sbi_platform_pmp_region_info(plat, hartid, i, &prot, &addr,
 						 &log2size))
 			continue;
-		pmp_set(i + 1, prot, addr, log2size);
+		rc = sbi_pmp_layout_add_napot(&layout, prot, addr, log2size);
+		if (rc)
+			return rc;
 	}
 
+	/*
+	 * Unlike programming each region with pmp_set(), this also disables
+	 * every unlocked entry after the layout, so no entry left over by a
+	 * previous boot stage stays active.
+	 */
+	rc = sbi_pmp_apply(scratch, 0, &layout);
+	if (rc)
+		return rc;
+
+	/* Entries after the firmware and platform regions are for enclaves */
+	sbi_pmp_reserve(scratch, layout.count);
+
 	return 0;
 }
 
@@ -218,7 +248,7 @@ int sbi_hart_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 	if (rc)
 		return rc;
 
-	return pmp_init(scratch, hartid);
+	return pmp_init(scratch, hartid, cold_boot);
 }
 
 void *sbi_hart_get_trap_info(struct sbi_scratch *scratch)
@@ -246,6 +276,7 @@ void sbi_hart_set_trap_info(struct sbi_scratch *scratch, void *data)
 
 void __attribute__((noreturn)) sbi_hart_hang(void)
 {
+	sbi_console_flush();
 	while (1)
 		wfi();
 	__builtin_unreachable();
@@ -0,0 +1,246 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_hsm.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_scratch.h>
+
+/*
+ * HART state machine of the SBI HSM extension
+ *
+ * Every HART but the cold boot one parks in STOPPED once initialized
+ * and only jumps to S-mode when sbi_hsm_hart_start() picks it. The
+ * start address, mode and argument are kept in the next_* fields of
+ * the target scratch. A start in M-mode calls next_addr in firmware
+ * instead, which the monitor uses to run code on a HART it owns.
+ */
+struct sbi_hsm_data {
+	atomic_t state;
+};
+
+static unsigned long hart_data_offset;
+
+/* Serializes starters, next_* must be written before STARTING shows */
+static spinlock_t hsm_start_lock = SPIN_LOCK_INITIALIZER;
+
+int sbi_hsm_hart_state_to_status(int state)
+{
+	int ret;
+
+	switch (state) {
+	case SBI_HART_STOPPED:
+		ret = SBI_HSM_HART_STATUS_STOPPED;
+		break;
+	case SBI_HART_STOPPING:
+		ret = SBI_HSM_HART_STATUS_STOP_PENDING;
+		break;
+	case SBI_HART_STARTING:
+		ret = SBI_HSM_HART_STATUS_START_PENDING;
+		break;
+	case SBI_HART_STARTED:
+		ret = SBI_HSM_HART_STATUS_STARTED;
+		break;
+	default:
+		ret = SBI_EINVAL;
+	}
+
+	return ret;
+}
+
+static struct sbi_hsm_data *hsm_data(struct sbi_scratch *scratch, u32 hartid)
+{
+	struct sbi_scratch *rscratch = sbi_hart_id_to_scratch(scratch, hartid);
+
+	return sbi_scratch_offset_ptr(rscratch, hart_data_offset);
+}
+
+static bool hsm_hart_valid(struct sbi_scratch *scratch, u32 hartid)
+{
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	return hartid < sbi_platform_hart_count(plat) &&
+	       !sbi_platform_hart_disabled(plat, hartid);
+}
+
+int sbi_hsm_hart_get_state(u32 hartid)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (!hsm_hart_valid(scratch, hartid))
+		return SBI_HART_UNKNOWN;
+
+	return atomic_read(&hsm_data(scratch, hartid)->state);
+}
+
+void sbi_hsm_prepare_next_jump(struct sbi_scratch *scratch, u32 hartid)
+{
+	struct sbi_hsm_data *hdata = hsm_data(scratch, hartid);
+
+	if (arch_atomic_cmpxchg(&hdata->state, SBI_HART_STARTING,
+				SBI_HART_STARTED) != SBI_HART_STARTING)
+		sbi_hart_hang();
+}
+
+static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
+{
+	unsigned long saved_mie;
+	struct sbi_hsm_data *hdata = hsm_data(scratch, hartid);
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	/* Only a start may wake the HART up */
+	saved_mie = csr_read(CSR_MIE);
+	csr_write(CSR_MIE, MIP_MSIP);
+
+	while (atomic_read(&hdata->state) != SBI_HART_STARTING)
+		wfi();
+
+	csr_write(CSR_MIE, saved_mie);
+
+	sbi_platform_ipi_clear(plat, hartid);
+}
+
+/**
+ * Wait in STOPPED until the HART is started, then jump to its new owner
+ *
+ * @param scratch pointer to sbi_scratch of the current HART
+ * @param hartid the current HART
+ */
+void __noreturn sbi_hsm_hart_park(struct sbi_scratch *scratch, u32 hartid)
+{
+	void (*mentry)(ulong hartid, ulong priv);
+
+	sbi_hsm_hart_wait(scratch, hartid);
+
+	sbi_hart_mark_available(hartid);
+	sbi_hsm_prepare_next_jump(scratch, hartid);
+
+	if (scratch->next_mode == PRV_M) {
+		mentry = (void *)scratch->next_addr;
+		mentry(hartid, scratch->next_arg1);
+		sbi_hart_hang();
+	}
+
+	sbi_hart_switch_mode(hartid, scratch->next_arg1, scratch->next_addr,
+			     scratch->next_mode, FALSE);
+}
+
+int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
+{
+	u32 i;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (cold_boot) {
+		hart_data_offset = sbi_scratch_alloc_offset(
+					sizeof(struct sbi_hsm_data), "HART_DATA");
+		if (!hart_data_offset)
+			return SBI_ENOMEM;
+
+		/* Only the cold boot HART starts on its own */
+		for (i = 0; i < sbi_platform_hart_count(plat); i++)
+			atomic_write(&hsm_data(scratch, i)->state,
+				     (i == hartid) ? SBI_HART_STARTING :
+						     SBI_HART_STOPPED);
+	} else if (!hart_data_offset) {
+		return SBI_ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * Leave S-mode for good and park the current HART
+ *
+ * Must follow a successful sbi_hsm_hart_stop().
+ */
+void __noreturn sbi_hsm_exit(struct sbi_scratch *scratch)
+{
+	u32 hartid = sbi_current_hartid();
+	struct sbi_hsm_data *hdata = hsm_data(scratch, hartid);
+
+	sbi_hart_unmark_available(hartid);
+
+	/* Acknowledge what was sent before the HART went away */
+	sbi_ipi_process(scratch);
+	csr_clear(CSR_MIP, MIP_STIP | MIP_SSIP);
+
+	if (arch_atomic_cmpxchg(&hdata->state, SBI_HART_STOPPING,
+				SBI_HART_STOPPED) != SBI_HART_STOPPING)
+		sbi_hart_hang();
+
+	sbi_hsm_hart_park(scratch, hartid);
+}
+
+/**
+ * Start a stopped HART at saddr in mode smode with priv in a1
+ *
+ * smode is PRV_S or PRV_U for the SBI call. PRV_M runs saddr as a
+ * firmware function taking (hartid, priv) that must not return.
+ */
+int sbi_hsm_hart_start(struct sbi_scratch *scratch, u32 hartid,
+		       ulong saddr, ulong smode, ulong priv)
+{
+	int ret = 0;
+	struct sbi_scratch *rscratch;
+	struct sbi_hsm_data *hdata;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (!hsm_hart_valid(scratch, hartid))
+		return SBI_EINVAL;
+	if (smode != PRV_S && smode != PRV_U && smode != PRV_M)
+		return SBI_EINVAL;
+
+	rscratch = sbi_hart_id_to_scratch(scratch, hartid);
+	hdata = sbi_scratch_offset_ptr(rscratch, hart_data_offset);
+
+	spin_lock(&hsm_start_lock);
+	switch (atomic_read(&hdata->state)) {
+	case SBI_HART_STOPPED:
+		rscratch->next_arg1 = priv;
+		rscratch->next_addr = saddr;
+		rscratch->next_mode = smode;
+		smp_wmb();
+		atomic_write(&hdata->state, SBI_HART_STARTING);
+		break;
+	case SBI_HART_STOPPING:
+		ret = SBI_EINVAL;
+		break;
+	default:
+		ret = SBI_EALREADY;
+	}
+	spin_unlock(&hsm_start_lock);
+
+	if (!ret)
+		sbi_platform_ipi_send(plat, hartid);
+
+	return ret;
+}
+
+/**
+ * Move the current HART to STOPPING
+ *
+ * With exitnow it is parked right away and this does not return.
+ */
+int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
+{
+	u32 hartid = sbi_current_hartid();
+	struct sbi_hsm_data *hdata = hsm_data(scratch, hartid);
+
+	if (arch_atomic_cmpxchg(&hdata->state, SBI_HART_STARTED,
+				SBI_HART_STOPPING) != SBI_HART_STARTED)
+		return SBI_DENIED;
+
+	if (exitnow)
+		sbi_hsm_exit(scratch);
+
+	return 0;
+}
@@ -13,6 +13,7 @@
 #include <sbi/sbi_emulate_csr.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_illegal_insn.h>
+#include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
 
@@ -133,6 +134,79 @@ static illegal_insn_func illegal_insn_table[32] = {
 	truly_illegal_insn  /* 31 */
 };
 
+/**
+ * Fast path for counter reads trapped from S/U-mode
+ *
+ * Cores without a readable time CSR trap on every rdtime. When the
+ * trapping instruction is reported in mtval and is a plain CSRR of
+ * cycle, time or instret, answer it right away without going through
+ * the generic decode and CSR emulation. Anything else, including reads
+ * from virtualized modes, is left to sbi_illegal_insn_handler().
+ *
+ * Returns 0 if the instruction was emulated.
+ */
+int sbi_illegal_insn_counter_fast(ulong insn, struct sbi_trap_regs *regs,
+				  struct sbi_scratch *scratch)
+{
+	ulong cen, val;
+	int csr_num;
+
+	if ((insn & INSN_MASK_CSRR) != INSN_MATCH_CSRR)
+		return SBI_ENOTSUPP;
+#if __riscv_xlen == 32
+	if (regs->mstatusH & MSTATUSH_MPV)
+#else
+	if (regs->mstatus & MSTATUS_MPV)
+#endif
+		return SBI_ENOTSUPP;
+
+	csr_num = insn >> 20;
+	if (csr_num < CSR_CYCLE || CSR_INSTRET < csr_num) {
+#if __riscv_xlen == 32
+		if (csr_num < CSR_CYCLEH || CSR_INSTRETH < csr_num)
+			return SBI_ENOTSUPP;
+#else
+		return SBI_ENOTSUPP;
+#endif
+	}
+
+	if (((regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT) == PRV_U) {
+		cen = csr_read(CSR_SCOUNTEREN);
+		if (!((cen >> (csr_num & 0x1f)) & 1))
+			return SBI_ENOTSUPP;
+	}
+
+	switch (csr_num) {
+	case CSR_CYCLE:
+		val = csr_read(CSR_MCYCLE);
+		break;
+	case CSR_TIME:
+		val = sbi_timer_value(scratch);
+		break;
+	case CSR_INSTRET:
+		val = csr_read(CSR_MINSTRET);
+		break;
+#if __riscv_xlen == 32
+	case CSR_CYCLEH:
+		val = csr_read(CSR_MCYCLEH);
+		break;
+	case CSR_TIMEH:
+		val = sbi_timer_value(scratch) >> 32;
+		break;
+	case CSR_INSTRETH:
+		val = csr_read(CSR_MINSTRETH);
+		break;
+#endif
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	SET_RD(insn, regs, val);
+	regs->mepc += 4;
+
+	return 0;
+}
+
 int sbi_illegal_insn_handler(u32 hartid, ulong mcause, ulong insn,
 			     struct sbi_trap_regs *regs,
 			     struct sbi_scratch *scratch)
@@ -16,7 +16,9 @@
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_penglai_hart.h>
 #include <sbi/sbi_platform.h>
+#include <sbi/sbi_trace.h>
 
 struct sbi_ipi_data {
 	unsigned long ipi_type;
@@ -26,24 +28,17 @@ static unsigned long ipi_data_off;
 
 static const struct sbi_ipi_event_ops *ipi_ops_array[SBI_IPI_EVENT_MAX];
 
-static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
-			u32 event, void *data)
+static int sbi_ipi_update(struct sbi_scratch *scratch, u32 remote_hartid,
+			  const struct sbi_ipi_event_ops *ipi_ops,
+			  u32 event, void *data)
 {
 	int ret;
 	struct sbi_scratch *remote_scratch = NULL;
-	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 	struct sbi_ipi_data *ipi_data;
-	const struct sbi_ipi_event_ops *ipi_ops;
-
-	if ((SBI_IPI_EVENT_MAX <= event) ||
-	    !ipi_ops_array[event] ||
-	    sbi_platform_hart_disabled(plat, remote_hartid))
-		return SBI_EINVAL;
-	ipi_ops = ipi_ops_array[event];
 
 	/*
-	 * Set IPI type on remote hart's scratch area and
-	 * trigger the interrupt
+	 * Set IPI type on remote hart's scratch area, the
+	 * interrupt is triggered later for the whole set
 	 */
 	remote_scratch = sbi_hart_id_to_scratch(scratch, remote_hartid);
 	ipi_data = sbi_scratch_offset_ptr(remote_scratch, ipi_data_off);
@@ -56,11 +51,6 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
 	}
 
 	atomic_raw_set_bit(event, &ipi_data->ipi_type);
-	smp_wmb();
-	sbi_platform_ipi_send(plat, remote_hartid);
-
-	if (ipi_ops->sync)
-		ipi_ops->sync(scratch);
 
 	return 0;
 }
@@ -69,6 +59,9 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
  * As this this function only handlers scalar values of hart mask, it must be
  * set to all online harts if the intention is to send IPIs to all the harts.
  * If hmask is zero, no IPIs will be sent.
+ *
+ * The event data of all the target harts is updated first, then the IPIs are
+ * triggered back-to-back and the sender waits only once for the whole set.
  */
 int sbi_ipi_send_many(struct sbi_scratch *scratch, ulong hmask, ulong hbase,
 			u32 event, void *data)
@@ -77,6 +70,12 @@ int sbi_ipi_send_many(struct sbi_scratch *scratch, ulong hmask, ulong hbase,
 	ulong mask = sbi_hart_available_mask();
 	ulong tempmask;
 	unsigned long last_bit = __fls(mask);
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+	const struct sbi_ipi_event_ops *ipi_ops;
+
+	if ((SBI_IPI_EVENT_MAX <= event) || !ipi_ops_array[event])
+		return SBI_EINVAL;
+	ipi_ops = ipi_ops_array[event];
 
 	if (hbase != -1UL) {
 		if (hbase > last_bit)
@@ -95,10 +94,24 @@ int sbi_ipi_send_many(struct sbi_scratch *scratch, ulong hmask, ulong hbase,
 		mask &= (hmask << hbase);
 	}
 
-	/* Send IPIs to every other hart on the set */
-	for (i = 0, m = mask; m; i++, m >>= 1)
-		if (m & 1UL)
-			sbi_ipi_send(scratch, i, event, data);
+	/* Update every hart on the set, dropping the ones that need no IPI */
+	for (i = 0, m = mask; m; i++, m >>= 1) {
+		if (!(m & 1UL))
+			continue;
+		if (sbi_platform_hart_disabled(plat, i) ||
+		    sbi_ipi_update(scratch, i, ipi_ops, event, data))
+			mask &= ~(1UL << i);
+	}
+
+	if (!mask)
+		return 0;
+
+	/* Trigger all the IPIs once the event data is visible */
+	smp_wmb();
+	sbi_platform_ipi_send_many(plat, mask);
+
+	if (ipi_ops->sync)
+		ipi_ops->sync(scratch);
 
 	return 0;
 }
@@ -186,6 +199,7 @@ void sbi_ipi_process(struct sbi_scratch *scratch)
 		if (!(ipi_type & 1UL))
 			goto skip;
 
+		sbi_trace(scratch, SBI_TRACE_IPI, ipi_event, 0, 0);
 		ipi_ops = ipi_ops_array[ipi_event];
 		if (ipi_ops && ipi_ops->process)
 			ipi_ops->process(scratch);
@@ -194,6 +208,8 @@ skip:
 		ipi_type = ipi_type >> 1;
 		ipi_event++;
 	};
+
+	sbi_penglai_hart_stop_pending(scratch);
 }
 
 int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
@@ -202,8 +218,8 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	struct sbi_ipi_data *ipi_data;
 
 	if (cold_boot) {
-		ipi_data_off = sbi_scratch_alloc_offset(sizeof(*ipi_data),
-							"IPI_DATA");
+		ipi_data_off = sbi_scratch_alloc_cacheline_offset(
+					sizeof(*ipi_data), "IPI_DATA");
 		if (!ipi_data_off)
 			return SBI_ENOMEM;
 		ret = sbi_ipi_event_create(&ipi_smode_ops);
@@ -0,0 +1,207 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_bits.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_measure.h>
+#include <sbi/sbi_string.h>
+
+/* Depth of the Merkle stack for SBI_MEASURE_MAX_PAGES leaves */
+#define MEASURE_STACK_DEPTH	21
+
+/*
+ * Only one measurement at a time is spread over other HARTs. Helpers
+ * claim batches of pages from measure_next and count them in
+ * measure_done once hashed. measure_active lets the owner wait until
+ * no helper can still be looking at its request.
+ */
+static spinlock_t measure_lock = SPIN_LOCK_INITIALIZER;
+static struct sbi_measure_req *volatile measure_cur;
+static atomic_t measure_next = ATOMIC_INITIALIZER(0);
+static atomic_t measure_done = ATOMIC_INITIALIZER(0);
+static atomic_t measure_active = ATOMIC_INITIALIZER(0);
+static u32 measure_event = SBI_IPI_EVENT_MAX;
+
+static void measure_leaf(struct sbi_measure_req *req, unsigned long i)
+{
+	struct sbi_sha256_ctx ctx;
+	const u8 prefix = 0;
+
+	if (req->dirty && !(req->dirty[BIT_WORD(i)] & BIT_MASK(i)))
+		return;
+
+	sbi_sha256_init(&ctx);
+	sbi_sha256_update(&ctx, &prefix, 1);
+	sbi_sha256_update(&ctx, (const void *)(req->base + i * PAGE_SIZE),
+			  PAGE_SIZE);
+	sbi_sha256_final(&ctx, req->digests[i]);
+
+	if (req->dirty)
+		atomic_raw_clear_bit(i, req->dirty);
+}
+
+static void measure_node(const u8 *left, const u8 *right, u8 *out)
+{
+	struct sbi_sha256_ctx ctx;
+	const u8 prefix = 1;
+
+	sbi_sha256_init(&ctx);
+	sbi_sha256_update(&ctx, &prefix, 1);
+	sbi_sha256_update(&ctx, left, SBI_SHA256_DIGEST_SIZE);
+	sbi_sha256_update(&ctx, right, SBI_SHA256_DIGEST_SIZE);
+	sbi_sha256_final(&ctx, out);
+}
+
+/*
+ * Build the root with a stack of complete subtrees: after leaf i, as
+ * many merges as trailing zeros of i + 1. The remaining subtrees are
+ * then folded right to left, which gives the RFC 6962 tree shape.
+ */
+static void measure_root(struct sbi_measure_req *req)
+{
+	u8 stack[MEASURE_STACK_DEPTH][SBI_SHA256_DIGEST_SIZE];
+	unsigned long i, j;
+	int top = -1;
+
+	for (i = 0; i < req->count; i++) {
+		sbi_memcpy(stack[++top], req->digests[i],
+			   SBI_SHA256_DIGEST_SIZE);
+		for (j = i + 1; !(j & 1); j >>= 1, top--)
+			measure_node(stack[top - 1], stack[top],
+				     stack[top - 1]);
+	}
+
+	for (; 0 < top; top--)
+		measure_node(stack[top - 1], stack[top], stack[top - 1]);
+
+	sbi_memcpy(req->root, stack[0], SBI_SHA256_DIGEST_SIZE);
+}
+
+static void measure_work(struct sbi_measure_req *req)
+{
+	unsigned long i, first, last;
+
+	while (1) {
+		first = atomic_add_return(&measure_next, SBI_MEASURE_BATCH) -
+			SBI_MEASURE_BATCH;
+		if (req->count <= first)
+			break;
+
+		last = first + SBI_MEASURE_BATCH;
+		if (req->count < last)
+			last = req->count;
+		for (i = first; i < last; i++)
+			measure_leaf(req, i);
+
+		atomic_add_return(&measure_done, last - first);
+	}
+}
+
+static void measure_process(struct sbi_scratch *scratch)
+{
+	struct sbi_measure_req *req;
+
+	atomic_add_return(&measure_active, 1);
+	smp_mb();
+
+	req = measure_cur;
+	if (req)
+		measure_work(req);
+
+	atomic_sub_return(&measure_active, 1);
+}
+
+static struct sbi_ipi_event_ops measure_ops = {
+	.name = "IPI_MEASURE",
+	.process = measure_process,
+};
+
+static bool measure_pending(struct sbi_measure_req *req)
+{
+	unsigned long i;
+
+	for (i = 0; i < BIT_WORD(req->count - 1) + 1; i++)
+		if (req->dirty[i])
+			return TRUE;
+
+	return FALSE;
+}
+
+/**
+ * Measure a region, hashing its changed pages on several HARTs
+ *
+ * The HARTs in hmask are interrupted to help with the leaf digests,
+ * the calling HART always takes part so the measurement completes
+ * even if none of them answers quickly. When another measurement
+ * already uses the helpers the calling HART does the work alone.
+ *
+ * @param scratch pointer to sbi_scratch of the current HART
+ * @param req the region and its cached digests
+ * @param hmask HARTs to borrow, may be 0
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_measure_pages(struct sbi_scratch *scratch,
+		      struct sbi_measure_req *req, ulong hmask)
+{
+	unsigned long i;
+
+	if (!req->count || SBI_MEASURE_MAX_PAGES < req->count ||
+	    !req->digests || (req->base & (PAGE_SIZE - 1)))
+		return SBI_EINVAL;
+
+	if (req->dirty && !measure_pending(req))
+		return 0;
+
+	hmask &= sbi_hart_available_mask() & ~(1UL << sbi_current_hartid());
+	if (!hmask || measure_event == SBI_IPI_EVENT_MAX ||
+	    !spin_trylock(&measure_lock)) {
+		for (i = 0; i < req->count; i++)
+			measure_leaf(req, i);
+		measure_root(req);
+		return 0;
+	}
+
+	atomic_write(&measure_next, 0);
+	atomic_write(&measure_done, 0);
+	measure_cur = req;
+	smp_mb();
+
+	sbi_ipi_send_many(scratch, hmask, 0, measure_event, NULL);
+	measure_work(req);
+	while (atomic_read(&measure_done) < req->count)
+		;
+
+	measure_cur = NULL;
+	smp_mb();
+	while (atomic_read(&measure_active))
+		;
+
+	spin_unlock(&measure_lock);
+
+	measure_root(req);
+
+	return 0;
+}
+
+int sbi_measure_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int ret;
+
+	if (!cold_boot)
+		return 0;
+
+	ret = sbi_ipi_event_create(&measure_ops);
+	if (ret < 0)
+		return ret;
+	measure_event = ret;
+
+	return 0;
+}
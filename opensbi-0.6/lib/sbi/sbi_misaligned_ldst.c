@@ -12,6 +12,7 @@
 #include <sbi/riscv_fp.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
 
@@ -21,6 +22,120 @@ union reg_data {
 	u64 data_u64;
 };
 
+static unsigned long misaligned_stats_off;
+
+struct sbi_misaligned_stats *sbi_misaligned_stats_ptr(struct sbi_scratch *scratch)
+{
+	if (!misaligned_stats_off)
+		return NULL;
+
+	return sbi_scratch_offset_ptr(scratch, misaligned_stats_off);
+}
+
+/*
+ * Keep the most frequent trapping PCs. A PC already in the table is
+ * counted in place, otherwise it takes over the least hit slot and
+ * inherits its count, so a hot PC always ends up in the table.
+ */
+static void misaligned_stats_update(struct sbi_scratch *scratch, ulong pc)
+{
+	u32 i, min = 0;
+	struct sbi_misaligned_stats *stats = sbi_misaligned_stats_ptr(scratch);
+
+	if (!stats)
+		return;
+
+	stats->count++;
+	for (i = 0; i < SBI_MISALIGNED_STATS_SLOTS; i++) {
+		if (stats->pc[i] == pc) {
+			stats->hits[i]++;
+			return;
+		}
+		if (stats->hits[i] < stats->hits[min])
+			min = i;
+	}
+
+	stats->pc[min] = pc;
+	stats->hits[min]++;
+}
+
+/*
+ * Load len bytes at a misaligned address using aligned ulong loads.
+ * An aligned ulong never crosses a page, so only the pages touched by
+ * the original access are touched here and a fault reports the first
+ * byte of the access within the faulting word.
+ */
+static u64 misaligned_load(ulong addr, int len, struct sbi_scratch *scratch,
+			   struct sbi_trap_info *uptrap)
+{
+	ulong word, base = addr & ~(sizeof(ulong) - 1);
+	ulong end = addr + len;
+	int done = 0;
+	u64 val = 0;
+
+	for (; base < end; base += sizeof(ulong)) {
+		word = sbi_load_ulong((const ulong *)base, scratch, uptrap);
+		if (uptrap->cause) {
+			uptrap->tval = (base < addr) ? addr : base;
+			return 0;
+		}
+		if (base < addr) {
+			word >>= 8 * (addr - base);
+			done = sizeof(ulong) - (addr - base);
+			val = word;
+		} else {
+			val |= (u64)word << (8 * done);
+			done += sizeof(ulong);
+		}
+	}
+
+	if (len < 8)
+		val &= (1ULL << (8 * len)) - 1;
+
+	return val;
+}
+
+/*
+ * Store len bytes at a misaligned address as naturally aligned pieces
+ * of up to one ulong. A read-modify-write of whole words would be
+ * fewer accesses but could undo concurrent stores to the neighbouring
+ * bytes made by other HARTs.
+ */
+static void misaligned_store(ulong addr, int len, u64 val,
+			     struct sbi_scratch *scratch,
+			     struct sbi_trap_info *uptrap)
+{
+	int chunk;
+
+	uptrap->cause = 0;
+	while (len) {
+		chunk = sizeof(ulong);
+		while (chunk > len || (addr & (chunk - 1)))
+			chunk >>= 1;
+
+		switch (chunk) {
+		case 1:
+			sbi_store_u8((u8 *)addr, val, scratch, uptrap);
+			break;
+		case 2:
+			sbi_store_u16((u16 *)addr, val, scratch, uptrap);
+			break;
+		case 4:
+			sbi_store_u32((u32 *)addr, val, scratch, uptrap);
+			break;
+		default:
+			sbi_store_u64((u64 *)addr, val, scratch, uptrap);
+			break;
+		}
+		if (uptrap->cause)
+			return;
+
+		addr += chunk;
+		len -= chunk;
+		val = (chunk < 8) ? val >> (8 * chunk) : 0;
+	}
+}
+
 int sbi_misaligned_load_handler(u32 hartid, ulong mcause,
 				ulong addr, ulong tval2, ulong tinst,
 				struct sbi_trap_regs *regs,
@@ -29,7 +144,7 @@ int sbi_misaligned_load_handler(u32 hartid, ulong mcause,
 	ulong insn;
 	union reg_data val;
 	struct sbi_trap_info uptrap;
-	int i, fp = 0, shift = 0, len = 0;
+	int fp = 0, shift = 0, len = 0;
 
 	if (tinst & 0x1) {
 		/*
@@ -119,14 +234,12 @@ int sbi_misaligned_load_handler(u32 hartid, ulong mcause,
 		return sbi_trap_redirect(regs, &uptrap, scratch);
 	}
 
-	val.data_u64 = 0;
-	for (i = 0; i < len; i++) {
-		val.data_bytes[i] = sbi_load_u8((void *)(addr + i),
-						scratch, &uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			return sbi_trap_redirect(regs, &uptrap, scratch);
-		}
+	misaligned_stats_update(scratch, regs->mepc);
+
+	val.data_u64 = misaligned_load(addr, len, scratch, &uptrap);
+	if (uptrap.cause) {
+		uptrap.epc = regs->mepc;
+		return sbi_trap_redirect(regs, &uptrap, scratch);
 	}
 
 	if (!fp)
@@ -151,7 +264,7 @@ int sbi_misaligned_store_handler(u32 hartid, ulong mcause,
 	ulong insn;
 	union reg_data val;
 	struct sbi_trap_info uptrap;
-	int i, len = 0;
+	int len = 0;
 
 	if (tinst & 0x1) {
 		/*
@@ -232,16 +345,29 @@ int sbi_misaligned_store_handler(u32 hartid, ulong mcause,
 		return sbi_trap_redirect(regs, &uptrap, scratch);
 	}
 
-	for (i = 0; i < len; i++) {
-		sbi_store_u8((void *)(addr + i), val.data_bytes[i],
-			     scratch, &uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			return sbi_trap_redirect(regs, &uptrap, scratch);
-		}
+	misaligned_stats_update(scratch, regs->mepc);
+
+	misaligned_store(addr, len, val.data_u64, scratch, &uptrap);
+	if (uptrap.cause) {
+		uptrap.epc = regs->mepc;
+		return sbi_trap_redirect(regs, &uptrap, scratch);
 	}
 
 	regs->mepc += INSN_LEN(insn);
 
 	return 0;
 }
+
+int sbi_misaligned_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		misaligned_stats_off = sbi_scratch_alloc_offset(
+					sizeof(struct sbi_misaligned_stats),
+					"MISALIGNED_STATS");
+		if (!misaligned_stats_off)
+			return SBI_ENOMEM;
+	} else if (!misaligned_stats_off)
+		return SBI_ENOMEM;
+
+	return 0;
+}
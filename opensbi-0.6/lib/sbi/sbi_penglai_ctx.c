@@ -0,0 +1,188 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_penglai_ctx.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_trap.h>
+
+/*
+ * Lazy FP switch between the host and enclaves
+ *
+ * mstatus.FS tells whether the outgoing side touched the FP registers
+ * since they were last loaded. A Dirty image is saved, a Clean one only
+ * if the registers do not already hold it. The incoming image is only
+ * loaded if the registers belong to another context, tracked per HART
+ * by context id so that a freed context is never taken for a new one.
+ *
+ * This only holds for enclaves. The host kernel turns FS off on trap
+ * entry while the registers still hold live user state, so FS says
+ * nothing about whether the host image changed: it is saved on every
+ * switch out of the host and restored on every switch back. Making the host side lazy as well would take
+ * the kernel reporting its FS state, or the enclave trapping on its
+ * first FP instruction, neither of which the SM supports.
+ */
+struct penglai_ctx_hart {
+	/** Id of the context whose image is in the FP registers */
+	unsigned long loaded;
+	struct sbi_penglai_ctx_stats stats;
+};
+
+static unsigned long ctx_hart_off;
+static atomic_t ctx_next_id = ATOMIC_INITIALIZER(0);
+
+#ifdef __riscv_flen
+
+#if __riscv_flen == 64
+#define FP_STORE	"fsd"
+#define FP_LOAD		"fld"
+#else
+#define FP_STORE	"fsw"
+#define FP_LOAD		"flw"
+#endif
+
+#define FP_OP(op, n)	op " f" #n ", " #n " * 8(%0)\n"
+#define FP_ALL(op)							\
+	FP_OP(op, 0)  FP_OP(op, 1)  FP_OP(op, 2)  FP_OP(op, 3)		\
+	FP_OP(op, 4)  FP_OP(op, 5)  FP_OP(op, 6)  FP_OP(op, 7)		\
+	FP_OP(op, 8)  FP_OP(op, 9)  FP_OP(op, 10) FP_OP(op, 11)		\
+	FP_OP(op, 12) FP_OP(op, 13) FP_OP(op, 14) FP_OP(op, 15)		\
+	FP_OP(op, 16) FP_OP(op, 17) FP_OP(op, 18) FP_OP(op, 19)		\
+	FP_OP(op, 20) FP_OP(op, 21) FP_OP(op, 22) FP_OP(op, 23)		\
+	FP_OP(op, 24) FP_OP(op, 25) FP_OP(op, 26) FP_OP(op, 27)		\
+	FP_OP(op, 28) FP_OP(op, 29) FP_OP(op, 30) FP_OP(op, 31)
+
+static void fp_save(struct sbi_penglai_fp_ctx *ctx)
+{
+	asm volatile(FP_ALL(FP_STORE) : : "r"(ctx->f) : "memory");
+	ctx->fcsr = csr_read(CSR_FCSR);
+}
+
+static void fp_restore(struct sbi_penglai_fp_ctx *ctx)
+{
+	asm volatile(FP_ALL(FP_LOAD) : : "r"(ctx->f) : "memory");
+	csr_write(CSR_FCSR, ctx->fcsr);
+}
+
+#else
+
+static void fp_save(struct sbi_penglai_fp_ctx *ctx)
+{
+}
+
+static void fp_restore(struct sbi_penglai_fp_ctx *ctx)
+{
+}
+
+#endif
+
+static struct penglai_ctx_hart *ctx_hart(struct sbi_scratch *scratch)
+{
+	return sbi_scratch_offset_ptr(scratch, ctx_hart_off);
+}
+
+void sbi_penglai_fp_ctx_init(struct sbi_penglai_fp_ctx *ctx, bool host)
+{
+	sbi_memset(ctx, 0, sizeof(*ctx));
+	ctx->id = atomic_add_return(&ctx_next_id, 1);
+	ctx->status = SBI_PENGLAI_FS_INITIAL;
+	ctx->host = host;
+}
+
+/**
+ * Hand the FP registers from prev over to next
+ *
+ * Called by the SM on every world switch, with regs being the trap
+ * frame it is about to return through. On return regs->mstatus carries
+ * the FS and XS state of next.
+ */
+void sbi_penglai_fp_switch(struct sbi_scratch *scratch,
+			   struct sbi_trap_regs *regs,
+			   struct sbi_penglai_fp_ctx *prev,
+			   struct sbi_penglai_fp_ctx *next)
+{
+	struct penglai_ctx_hart *ch = ctx_hart(scratch);
+	unsigned long fs = regs->mstatus & MSTATUS_FS;
+	unsigned long status;
+
+	prev->status = regs->mstatus & (MSTATUS_FS | MSTATUS_XS);
+	if (prev->host || fs == SBI_PENGLAI_FS_DIRTY ||
+	    (fs == SBI_PENGLAI_FS_CLEAN && ch->loaded != prev->id)) {
+		csr_set(CSR_MSTATUS, MSTATUS_FS);
+		fp_save(prev);
+		ch->loaded = prev->id;
+		ch->stats.fp[SBI_PENGLAI_FP_SAVED]++;
+		if (!prev->host)
+			prev->status = (prev->status & ~MSTATUS_FS) |
+				       SBI_PENGLAI_FS_CLEAN;
+	}
+
+	if (ch->loaded == next->id) {
+		ch->stats.fp[SBI_PENGLAI_FP_SKIPPED]++;
+	} else {
+		/* Never leave the registers of one side visible to the other */
+		csr_set(CSR_MSTATUS, MSTATUS_FS);
+		status = next->status & MSTATUS_FS;
+		if (!next->host && (status == SBI_PENGLAI_FS_OFF ||
+				    status == SBI_PENGLAI_FS_INITIAL)) {
+			sbi_memset(next->f, 0, sizeof(next->f));
+			next->fcsr = 0;
+		}
+		fp_restore(next);
+		ch->loaded = next->id;
+		ch->stats.fp[SBI_PENGLAI_FP_RESTORED]++;
+		if (!next->host && status == SBI_PENGLAI_FS_DIRTY)
+			next->status = (next->status & ~MSTATUS_FS) |
+				       SBI_PENGLAI_FS_CLEAN;
+	}
+
+	regs->mstatus &= ~(MSTATUS_FS | MSTATUS_XS);
+	regs->mstatus |= next->status & (MSTATUS_FS | MSTATUS_XS);
+}
+
+void sbi_penglai_switch_end(struct sbi_scratch *scratch, u32 kind,
+			    unsigned long start)
+{
+	struct sbi_penglai_ctx_stats *stats = sbi_penglai_ctx_stats_ptr(scratch);
+	unsigned long cycles = csr_read(CSR_MCYCLE) - start;
+
+	if (!stats || SBI_PENGLAI_SWITCH_KINDS <= kind)
+		return;
+
+	stats->count[kind]++;
+	stats->cycles[kind] += cycles;
+	if (stats->max[kind] < cycles)
+		stats->max[kind] = cycles;
+}
+
+struct sbi_penglai_ctx_stats *
+sbi_penglai_ctx_stats_ptr(struct sbi_scratch *scratch)
+{
+	if (!ctx_hart_off)
+		return NULL;
+
+	return &ctx_hart(scratch)->stats;
+}
+
+int sbi_penglai_ctx_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		ctx_hart_off = sbi_scratch_alloc_offset(
+					sizeof(struct penglai_ctx_hart),
+					"PENGLAI_CTX");
+		if (!ctx_hart_off)
+			return SBI_ENOMEM;
+	} else if (!ctx_hart_off) {
+		return SBI_ENOMEM;
+	}
+
+	/* Nothing of any context is in the FP registers yet */
+	sbi_memset(ctx_hart(scratch), 0, sizeof(struct penglai_ctx_hart));
+
+	return 0;
+}
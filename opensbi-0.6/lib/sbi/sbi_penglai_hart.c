@@ -0,0 +1,228 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_hsm.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_penglai_hart.h>
+
+/*
+ * Run enclave threads on this HART until it is released; the SM enters
+ * the enclave with mret and never comes back here, see sm/sm.c.
+ */
+extern void sm_enclave_hart_enter(unsigned long eid);
+/* Take the enclave thread off this HART so it can run elsewhere */
+extern void sm_enclave_hart_leave(unsigned long eid);
+
+/*
+ * HARTs dedicated to one enclave
+ *
+ * The host stops a HART through HSM (CPU hotplug), then hands it over.
+ * The monitor starts it in M-mode straight into the enclave, where no
+ * host tick or IPI reaches it: the host can neither start it again nor
+ * target it with S-mode IPIs or remote fences until it is released.
+ */
+#define PENGLAI_HART_MAX	__riscv_xlen
+/* Polls of the HART state before a release gives up */
+#define PENGLAI_HART_RELEASE_SPINS	0x1000000
+
+enum {
+	PENGLAI_HART_HOST = 0,
+	PENGLAI_HART_ENCLAVE,
+	PENGLAI_HART_RELEASING,
+};
+
+static spinlock_t penglai_hart_lock = SPIN_LOCK_INITIALIZER;
+static u32 penglai_hart_state[PENGLAI_HART_MAX];
+static unsigned long penglai_hart_eid[PENGLAI_HART_MAX];
+/* Bit set for every HART not owned by the host */
+static volatile unsigned long penglai_hart_enclave_mask;
+static u32 penglai_hart_event = SBI_IPI_EVENT_MAX;
+/* Release requests seen by the IPI handler, acted on after all events */
+static volatile bool penglai_hart_stop[PENGLAI_HART_MAX];
+
+static void penglai_hart_entry(ulong hartid, ulong eid)
+{
+	sm_enclave_hart_enter(eid);
+}
+
+/*
+ * Stopping does not return, so doing it here would drop the events
+ * after this one in the same IPI. It is done by
+ * sbi_penglai_hart_stop_pending() once they are all processed.
+ */
+static void penglai_hart_process(struct sbi_scratch *scratch)
+{
+	u32 hartid = sbi_current_hartid();
+
+	if (penglai_hart_state[hartid] == PENGLAI_HART_RELEASING)
+		penglai_hart_stop[hartid] = TRUE;
+}
+
+/**
+ * Leave the enclave and stop current HART if it is being released
+ *
+ * Called at the end of IPI processing. Does not return in that case.
+ */
+void sbi_penglai_hart_stop_pending(struct sbi_scratch *scratch)
+{
+	u32 hartid = sbi_current_hartid();
+
+	if (PENGLAI_HART_MAX <= hartid || !penglai_hart_stop[hartid])
+		return;
+
+	penglai_hart_stop[hartid] = FALSE;
+	sm_enclave_hart_leave(penglai_hart_eid[hartid]);
+	sbi_hsm_hart_stop(scratch, TRUE);
+}
+
+static struct sbi_ipi_event_ops penglai_hart_ops = {
+	.name = "IPI_PENGLAI_HART",
+	.process = penglai_hart_process,
+};
+
+/**
+ * Dedicate a stopped HART to an enclave
+ *
+ * The host must have stopped the HART with HSM first. From then on it
+ * only runs the enclave, until sbi_penglai_hart_release().
+ */
+int sbi_penglai_hart_assign(struct sbi_scratch *scratch, u32 hartid,
+			    unsigned long eid)
+{
+	int ret = 0;
+
+	if (PENGLAI_HART_MAX <= hartid || hartid == sbi_current_hartid())
+		return SBI_EINVAL;
+
+	spin_lock(&penglai_hart_lock);
+	if (penglai_hart_state[hartid] != PENGLAI_HART_HOST)
+		ret = SBI_EALREADY;
+	else if (sbi_hsm_hart_get_state(hartid) != SBI_HART_STOPPED)
+		ret = SBI_DENIED;
+	if (!ret) {
+		penglai_hart_eid[hartid] = eid;
+		penglai_hart_state[hartid] = PENGLAI_HART_ENCLAVE;
+		penglai_hart_enclave_mask |= 1UL << hartid;
+	}
+	spin_unlock(&penglai_hart_lock);
+
+	if (ret)
+		return ret;
+
+	ret = sbi_hsm_hart_start(scratch, hartid, (ulong)penglai_hart_entry,
+				 PRV_M, eid);
+	if (ret) {
+		spin_lock(&penglai_hart_lock);
+		penglai_hart_state[hartid] = PENGLAI_HART_HOST;
+		penglai_hart_enclave_mask &= ~(1UL << hartid);
+		spin_unlock(&penglai_hart_lock);
+	}
+
+	return ret;
+}
+
+/**
+ * Give an enclave HART back to the host
+ *
+ * Returns once the HART is stopped again, the host then starts it
+ * with HSM like any other offline CPU. Returns SBI_ETIMEDOUT if the
+ * HART does not stop in time; it then stays with the enclave and the
+ * release may be retried.
+ */
+int sbi_penglai_hart_release(struct sbi_scratch *scratch, u32 hartid)
+{
+	int ret = 0;
+	unsigned long spins = 0;
+
+	if (PENGLAI_HART_MAX <= hartid || hartid == sbi_current_hartid())
+		return SBI_EINVAL;
+
+	spin_lock(&penglai_hart_lock);
+	if (penglai_hart_state[hartid] != PENGLAI_HART_ENCLAVE)
+		ret = SBI_EINVAL;
+	else
+		penglai_hart_state[hartid] = PENGLAI_HART_RELEASING;
+	spin_unlock(&penglai_hart_lock);
+
+	if (ret)
+		return ret;
+
+	smp_wmb();
+	while (sbi_hsm_hart_get_state(hartid) != SBI_HART_STOPPED) {
+		/* Resent until the HART is up to receive it */
+		sbi_ipi_send_many(scratch, 1UL << hartid, 0,
+				  penglai_hart_event, NULL);
+		while (sbi_hsm_hart_get_state(hartid) == SBI_HART_STARTED &&
+		       spins < PENGLAI_HART_RELEASE_SPINS) {
+			spins++;
+			cpu_relax();
+		}
+		if (PENGLAI_HART_RELEASE_SPINS <= spins++) {
+			ret = SBI_ETIMEDOUT;
+			break;
+		}
+	}
+
+	spin_lock(&penglai_hart_lock);
+	if (ret) {
+		penglai_hart_state[hartid] = PENGLAI_HART_ENCLAVE;
+	} else {
+		penglai_hart_state[hartid] = PENGLAI_HART_HOST;
+		penglai_hart_enclave_mask &= ~(1UL << hartid);
+	}
+	spin_unlock(&penglai_hart_lock);
+
+	return ret;
+}
+
+bool sbi_penglai_hart_is_host(u32 hartid)
+{
+	if (PENGLAI_HART_MAX <= hartid)
+		return TRUE;
+
+	return !(penglai_hart_enclave_mask & (1UL << hartid));
+}
+
+/**
+ * Drop enclave HARTs from a hart mask supplied by the host
+ *
+ * An hbase of -1UL (all available HARTs) is turned into an explicit
+ * mask so that the enclave HARTs can be removed from it.
+ */
+void sbi_penglai_hart_filter(ulong *hmask, ulong *hbase)
+{
+	unsigned long enclave = penglai_hart_enclave_mask;
+
+	if (!enclave)
+		return;
+
+	if (*hbase == -1UL) {
+		*hmask = sbi_hart_available_mask();
+		*hbase = 0;
+	}
+
+	if (*hbase < BITS_PER_LONG)
+		*hmask &= ~(enclave >> *hbase);
+}
+
+int sbi_penglai_hart_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int ret;
+
+	if (!cold_boot)
+		return 0;
+
+	ret = sbi_ipi_event_create(&penglai_hart_ops);
+	if (ret < 0)
+		return ret;
+	penglai_hart_event = ret;
+
+	return 0;
+}
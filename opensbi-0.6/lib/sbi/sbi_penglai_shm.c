@@ -0,0 +1,383 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_penglai_shm.h>
+#include <sbi/sbi_penglai_sm.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_secmem.h>
+#include <sbi/sbi_string.h>
+
+/*
+ * Shared region mappings in the enclave page tables, see sm/enclave.c.
+ * Unmapping flushes the TLB of every HART running the enclave before
+ * it returns. All return 0 on success.
+ */
+extern uintptr_t sm_shm_map(unsigned long eid, unsigned long paddr,
+			    unsigned long size, unsigned long prot,
+			    unsigned long *va);
+extern uintptr_t sm_shm_unmap(unsigned long eid, unsigned long paddr,
+			      unsigned long size);
+/* Put secure memory behind or take it out of the enclave PMP, see sm/pmp.c */
+extern uintptr_t sm_shm_protect(unsigned long paddr, unsigned long size);
+extern uintptr_t sm_shm_release(unsigned long paddr, unsigned long size);
+
+struct penglai_shm_grant {
+	/** Enclave the region is mapped in */
+	unsigned long eid;
+	/** SBI_PENGLAI_SHM_READ/WRITE, zero while being mapped */
+	unsigned long prot;
+	/** Slot in use */
+	bool used;
+};
+
+struct penglai_shm {
+	/** Slot state */
+	enum {
+		SHM_FREE = 0,
+		SHM_BUSY,
+		SHM_LIVE,
+	} state;
+	/** Name chosen by the host */
+	unsigned long key;
+	unsigned long flags;
+	unsigned long paddr;
+	unsigned long size;
+	/** Size taken from the secure reserve, rounded up to a block */
+	unsigned long reserved;
+	struct penglai_shm_grant grants[SBI_PENGLAI_SHM_MAX_GRANTS];
+};
+
+static spinlock_t shm_lock = SPIN_LOCK_INITIALIZER;
+static struct penglai_shm shms[SBI_PENGLAI_SHM_MAX];
+
+static unsigned long shm_reserved_size(unsigned long size)
+{
+	unsigned long reserved = SBI_SECMEM_CHUNK_SIZE;
+
+	while (reserved < size)
+		reserved <<= 1;
+
+	return reserved;
+}
+
+/* Called with shm_lock held */
+static bool shm_overlaps(unsigned long paddr, unsigned long size)
+{
+	u32 i;
+
+	for (i = 0; i < SBI_PENGLAI_SHM_MAX; i++)
+		if (shms[i].state != SHM_FREE && shms[i].paddr &&
+		    paddr < shms[i].paddr + shms[i].size &&
+		    shms[i].paddr < paddr + size)
+			return TRUE;
+
+	return FALSE;
+}
+
+/*
+ * Host regions must stay clear of the firmware, of secure memory, of the
+ * reserve and of each other. Called with shm_lock held, which keeps
+ * donations from claiming the range until the region is registered.
+ */
+static bool shm_host_range_valid(unsigned long paddr, unsigned long size)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (paddr + size < paddr)
+		return FALSE;
+	if (paddr < scratch->fw_start + scratch->fw_size &&
+	    scratch->fw_start < paddr + size)
+		return FALSE;
+
+	if (check_mem_overlap(paddr, size) ||
+	    sbi_secmem_overlaps_reserve(paddr, size))
+		return FALSE;
+
+	return !shm_overlaps(paddr, size);
+}
+
+/**
+ * Call fn on a range of host memory unless it overlaps a shared region
+ *
+ * Used by donations to the reserve and to the SM, which must never
+ * claim memory an enclave or the host may still map as shared.
+ * Returns SBI_DENIED on overlap, otherwise the result of fn.
+ */
+int sbi_penglai_shm_exclude(unsigned long base, unsigned long size,
+			    int (*fn)(unsigned long base, unsigned long size))
+{
+	int rc;
+
+	spin_lock(&shm_lock);
+	if (shm_overlaps(base, size))
+		rc = SBI_DENIED;
+	else
+		rc = fn(base, size);
+	spin_unlock(&shm_lock);
+
+	return rc;
+}
+
+/**
+ * Register a named shared region
+ *
+ * With a non-zero paddr the region is host memory the host maps itself,
+ * the SM refuses to map it if it overlaps secure memory. With a zero
+ * paddr the region is taken from the secure reserve and only enclaves
+ * can ever see it.
+ */
+int sbi_penglai_shm_create(unsigned long key, unsigned long paddr,
+			   unsigned long size, unsigned long *id)
+{
+	u32 i;
+	int ret = 0;
+	unsigned long reserved = 0, base = 0;
+	struct penglai_shm *s = NULL;
+
+	if (!size || ((paddr | size) & (PAGE_SIZE - 1)))
+		return SBI_EINVAL;
+
+	spin_lock(&shm_lock);
+	for (i = 0; i < SBI_PENGLAI_SHM_MAX; i++) {
+		if (shms[i].state != SHM_FREE && shms[i].key == key) {
+			ret = SBI_EINVAL;
+			break;
+		}
+		if (!s && shms[i].state == SHM_FREE)
+			s = &shms[i];
+	}
+	if (!ret && !s)
+		ret = SBI_ENOSPC;
+	if (!ret && paddr && !shm_host_range_valid(paddr, size))
+		ret = SBI_INVALID_ADDR;
+	if (!ret) {
+		sbi_memset(s, 0, sizeof(*s));
+		s->key = key;
+		s->paddr = paddr;
+		s->size = size;
+		s->state = SHM_BUSY;
+	}
+	spin_unlock(&shm_lock);
+
+	if (ret)
+		return ret;
+
+	if (paddr) {
+		s->flags = SBI_PENGLAI_SHM_HOST;
+	} else {
+		/*
+		 * Taken under the lock, so that a donation never sees the
+		 * block out of the reserve without seeing the region
+		 */
+		reserved = shm_reserved_size(size);
+		spin_lock(&shm_lock);
+		base = s->paddr = sbi_secmem_take(reserved);
+		spin_unlock(&shm_lock);
+		if (!base) {
+			ret = SBI_ENOMEM;
+		} else if (sm_shm_protect(base, reserved)) {
+			ret = SBI_EFAIL;
+		} else {
+			sbi_memset((void *)base, 0, size);
+			s->reserved = reserved;
+		}
+	}
+
+	spin_lock(&shm_lock);
+	s->state = ret ? SHM_FREE : SHM_LIVE;
+	spin_unlock(&shm_lock);
+
+	/* Only once the slot is free, or the region would refuse it */
+	if (ret && base)
+		sbi_secmem_donate(base, reserved);
+
+	if (!ret)
+		*id = s - shms;
+
+	return ret;
+}
+
+int sbi_penglai_shm_lookup(unsigned long key, unsigned long *id)
+{
+	u32 i;
+	int ret = SBI_ENOENT;
+
+	spin_lock(&shm_lock);
+	for (i = 0; i < SBI_PENGLAI_SHM_MAX; i++) {
+		if (shms[i].state == SHM_LIVE && shms[i].key == key) {
+			*id = i;
+			ret = 0;
+			break;
+		}
+	}
+	spin_unlock(&shm_lock);
+
+	return ret;
+}
+
+/**
+ * Map a region into an enclave
+ *
+ * Several enclaves may hold the same region, each with its own access.
+ * The enclave virtual address chosen by the SM is returned in va.
+ */
+int sbi_penglai_shm_grant(unsigned long id, unsigned long eid,
+			  unsigned long prot, unsigned long *va)
+{
+	u32 i;
+	int ret = 0;
+	struct penglai_shm *s;
+	struct penglai_shm_grant *g = NULL;
+
+	if (SBI_PENGLAI_SHM_MAX <= id || !prot ||
+	    (prot & ~(SBI_PENGLAI_SHM_READ | SBI_PENGLAI_SHM_WRITE)))
+		return SBI_EINVAL;
+
+	s = &shms[id];
+	spin_lock(&shm_lock);
+	if (s->state != SHM_LIVE)
+		ret = SBI_EINVAL;
+	for (i = 0; !ret && i < SBI_PENGLAI_SHM_MAX_GRANTS; i++) {
+		if (s->grants[i].used && s->grants[i].eid == eid)
+			ret = SBI_EINVAL;
+		else if (!g && !s->grants[i].used)
+			g = &s->grants[i];
+	}
+	if (!ret && !g)
+		ret = SBI_ENOSPC;
+	if (!ret) {
+		g->eid = eid;
+		g->prot = 0;
+		g->used = TRUE;
+	}
+	spin_unlock(&shm_lock);
+
+	if (ret)
+		return ret;
+
+	/* Page table updates may be long, so not under the lock */
+	ret = sm_shm_map(eid, s->paddr, s->size, prot, va) ? SBI_EFAIL : 0;
+
+	spin_lock(&shm_lock);
+	if (ret)
+		g->used = FALSE;
+	else
+		g->prot = prot;
+	spin_unlock(&shm_lock);
+
+	return ret;
+}
+
+/* Called with shm_lock held, drops it around the unmap */
+static int shm_revoke_grant(struct penglai_shm *s, struct penglai_shm_grant *g)
+{
+	int ret;
+	unsigned long eid = g->eid;
+
+	g->prot = 0;
+	spin_unlock(&shm_lock);
+	ret = sm_shm_unmap(eid, s->paddr, s->size) ? SBI_EFAIL : 0;
+	spin_lock(&shm_lock);
+	g->used = FALSE;
+
+	return ret;
+}
+
+/**
+ * Unmap a region from an enclave
+ *
+ * Once this returns the enclave can no longer reach the region from
+ * any HART.
+ */
+int sbi_penglai_shm_revoke(unsigned long id, unsigned long eid)
+{
+	u32 i;
+	int ret = SBI_EINVAL;
+	struct penglai_shm *s;
+
+	if (SBI_PENGLAI_SHM_MAX <= id)
+		return SBI_EINVAL;
+
+	s = &shms[id];
+	spin_lock(&shm_lock);
+	for (i = 0; s->state == SHM_LIVE && i < SBI_PENGLAI_SHM_MAX_GRANTS;
+	     i++) {
+		if (s->grants[i].used && s->grants[i].prot &&
+		    s->grants[i].eid == eid) {
+			ret = shm_revoke_grant(s, &s->grants[i]);
+			break;
+		}
+	}
+	spin_unlock(&shm_lock);
+
+	return ret;
+}
+
+/* Drop every grant of an enclave being destroyed, see sm/enclave.c */
+void sbi_penglai_shm_revoke_all(unsigned long eid)
+{
+	u32 i, j;
+
+	spin_lock(&shm_lock);
+	for (i = 0; i < SBI_PENGLAI_SHM_MAX; i++) {
+		if (shms[i].state != SHM_LIVE)
+			continue;
+		for (j = 0; j < SBI_PENGLAI_SHM_MAX_GRANTS; j++)
+			if (shms[i].grants[j].used && shms[i].grants[j].prot &&
+			    shms[i].grants[j].eid == eid)
+				shm_revoke_grant(&shms[i], &shms[i].grants[j]);
+	}
+	spin_unlock(&shm_lock);
+}
+
+/**
+ * Retire a region
+ *
+ * Refused while any enclave still maps it. Secure regions go back to
+ * the reserve, host regions are simply forgotten.
+ */
+int sbi_penglai_shm_destroy(unsigned long id)
+{
+	u32 i;
+	int ret = 0;
+	struct penglai_shm *s;
+	unsigned long paddr, reserved;
+
+	if (SBI_PENGLAI_SHM_MAX <= id)
+		return SBI_EINVAL;
+
+	s = &shms[id];
+	spin_lock(&shm_lock);
+	if (s->state != SHM_LIVE)
+		ret = SBI_EINVAL;
+	for (i = 0; !ret && i < SBI_PENGLAI_SHM_MAX_GRANTS; i++)
+		if (s->grants[i].used)
+			ret = SBI_DENIED;
+	if (!ret)
+		s->state = SHM_BUSY;
+	spin_unlock(&shm_lock);
+
+	if (ret)
+		return ret;
+
+	paddr = s->paddr;
+	reserved = s->reserved;
+	if (reserved) {
+		sbi_memset((void *)paddr, 0, s->size);
+		sm_shm_release(paddr, reserved);
+	}
+
+	spin_lock(&shm_lock);
+	s->state = SHM_FREE;
+	spin_unlock(&shm_lock);
+
+	/* Only once the slot is free, or the region would refuse it */
+	if (reserved)
+		sbi_secmem_donate(paddr, reserved);
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_penglai_tmpl.h>
+#include <sbi/sbi_string.h>
+
+/*
+ * Turn a created but never run enclave into a read-only template image,
+ * see sm/sm.c. Returns 0 on success.
+ */
+extern uintptr_t sm_enclave_freeze(unsigned long eid,
+				   struct sbi_penglai_tmpl_image *image);
+
+struct penglai_tmpl {
+	/** Slot state */
+	enum {
+		TMPL_FREE = 0,
+		TMPL_BUSY,
+		TMPL_LIVE,
+	} state;
+	/** Template enclave */
+	unsigned long eid;
+	/** Clones alive, the image must outlive them */
+	unsigned long clones;
+	struct sbi_penglai_tmpl_image image;
+};
+
+static spinlock_t tmpl_lock = SPIN_LOCK_INITIALIZER;
+static struct penglai_tmpl tmpls[SBI_PENGLAI_TMPL_MAX];
+
+/**
+ * Make an enclave the template of future clones
+ *
+ * The enclave is loaded and measured once by the normal create path,
+ * clones then skip both steps.
+ */
+int sbi_penglai_tmpl_create(unsigned long eid, unsigned long *id)
+{
+	u32 i;
+	int ret;
+	struct penglai_tmpl *t = NULL;
+
+	spin_lock(&tmpl_lock);
+	for (i = 0; i < SBI_PENGLAI_TMPL_MAX; i++) {
+		if (tmpls[i].state == TMPL_LIVE && tmpls[i].eid == eid) {
+			spin_unlock(&tmpl_lock);
+			return SBI_EINVAL;
+		}
+		if (!t && tmpls[i].state == TMPL_FREE)
+			t = &tmpls[i];
+	}
+	if (t)
+		t->state = TMPL_BUSY;
+	spin_unlock(&tmpl_lock);
+
+	if (!t)
+		return SBI_ENOSPC;
+
+	/* Freezing may walk the whole image, so not under the lock */
+	ret = sm_enclave_freeze(eid, &t->image);
+
+	spin_lock(&tmpl_lock);
+	if (ret) {
+		t->state = TMPL_FREE;
+	} else {
+		t->eid = eid;
+		t->clones = 0;
+		t->state = TMPL_LIVE;
+	}
+	spin_unlock(&tmpl_lock);
+
+	if (ret)
+		return SBI_EINVAL;
+
+	*id = t - tmpls;
+
+	return 0;
+}
+
+/**
+ * Take a reference on a template for a new clone
+ *
+ * The reference is dropped with sbi_penglai_tmpl_put() when the clone
+ * could not be created or once it is destroyed.
+ */
+int sbi_penglai_tmpl_get(unsigned long id,
+			 const struct sbi_penglai_tmpl_image **image)
+{
+	int ret = SBI_EINVAL;
+
+	if (SBI_PENGLAI_TMPL_MAX <= id)
+		return SBI_EINVAL;
+
+	spin_lock(&tmpl_lock);
+	if (tmpls[id].state == TMPL_LIVE) {
+		tmpls[id].clones++;
+		*image = &tmpls[id].image;
+		ret = 0;
+	}
+	spin_unlock(&tmpl_lock);
+
+	return ret;
+}
+
+void sbi_penglai_tmpl_put(unsigned long id)
+{
+	if (SBI_PENGLAI_TMPL_MAX <= id)
+		return;
+
+	spin_lock(&tmpl_lock);
+	if (tmpls[id].state == TMPL_LIVE && tmpls[id].clones)
+		tmpls[id].clones--;
+	spin_unlock(&tmpl_lock);
+}
+
+/**
+ * Retire a template
+ *
+ * Refused while clones still share its pages. The template enclave
+ * itself is then destroyed by the host like any other enclave.
+ */
+int sbi_penglai_tmpl_destroy(unsigned long id)
+{
+	int ret = SBI_EINVAL;
+
+	if (SBI_PENGLAI_TMPL_MAX <= id)
+		return SBI_EINVAL;
+
+	spin_lock(&tmpl_lock);
+	if (tmpls[id].state == TMPL_LIVE) {
+		if (tmpls[id].clones) {
+			ret = SBI_DENIED;
+		} else {
+			sbi_memset(&tmpls[id], 0, sizeof(tmpls[id]));
+			ret = 0;
+		}
+	}
+	spin_unlock(&tmpl_lock);
+
+	return ret;
+}
+
+/**
+ * Resolve a write fault of a clone on a shared page
+ *
+ * Called by the SM page fault path with a page of the template image
+ * and a free page of the clone. The SM maps the copy writable in the
+ * clone afterwards, the template page itself is never written. A
+ * reference is held over the copy so the template can't be retired
+ * under it.
+ */
+int sbi_penglai_tmpl_cow(unsigned long id, unsigned long src,
+			 unsigned long dst)
+{
+	int ret;
+	const struct sbi_penglai_tmpl_image *image;
+
+	if ((src | dst) & (PAGE_SIZE - 1))
+		return SBI_EINVAL;
+
+	ret = sbi_penglai_tmpl_get(id, &image);
+	if (ret)
+		return ret;
+
+	if (src < image->paddr ||
+	    image->paddr + image->size < src + PAGE_SIZE ||
+	    (dst < image->paddr + image->size &&
+	     image->paddr < dst + PAGE_SIZE))
+		ret = SBI_EINVAL;
+	else
+		sbi_memcpy((void *)dst, (const void *)src, PAGE_SIZE);
+
+	sbi_penglai_tmpl_put(id);
+
+	return ret;
+}
@@ -0,0 +1,360 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_pmp.h>
+#include <sbi/sbi_scratch.h>
+
+/* clang-format off */
+
+#if __riscv_xlen == 32
+#define SBI_PMP_CFG_PER_CSR		4
+#define SBI_PMP_CFG_CSR(n)		(CSR_PMPCFG0 + ((n) / 4))
+#else
+#define SBI_PMP_CFG_PER_CSR		8
+#define SBI_PMP_CFG_CSR(n)		(CSR_PMPCFG0 + ((n) / 8) * 2)
+#endif
+
+#define SBI_PMP_PROT_MASK		(PMP_R | PMP_W | PMP_X | PMP_L)
+
+/* clang-format on */
+
+/** Per-HART copy of the PMP CSRs, so unchanged entries are not rewritten */
+struct sbi_pmp_shadow {
+	/** Number of entries reserved by the firmware at boot */
+	u32 reserved;
+	u8 cfg[PMP_COUNT];
+	unsigned long addr[PMP_COUNT];
+};
+
+static unsigned long pmp_shadow_off;
+
+static unsigned long pmp_log2(unsigned long x)
+{
+	unsigned long ret = 0;
+
+	while (x > 1UL) {
+		ret++;
+		x = x >> 1;
+	}
+
+	return ret;
+}
+
+static int pmp_layout_push(struct sbi_pmp_layout *layout,
+			   unsigned long cfg, unsigned long addr)
+{
+	if (PMP_COUNT <= layout->count)
+		return SBI_ENOSPC;
+
+	layout->entries[layout->count].cfg = cfg;
+	layout->entries[layout->count].addr = addr;
+	layout->count++;
+
+	return 0;
+}
+
+void sbi_pmp_layout_init(struct sbi_pmp_layout *layout)
+{
+	layout->count = 0;
+}
+
+/**
+ * Add a naturally aligned power-of-two region, same encoding as pmp_set()
+ */
+int sbi_pmp_layout_add_napot(struct sbi_pmp_layout *layout, unsigned long prot,
+			     unsigned long addr, unsigned long log2len)
+{
+	unsigned long addrmask, pmpaddr;
+
+	if (log2len > __riscv_xlen || log2len < PMP_SHIFT)
+		return SBI_EINVAL;
+
+	prot &= SBI_PMP_PROT_MASK;
+	if (log2len == PMP_SHIFT) {
+		prot |= PMP_A_NA4;
+		pmpaddr = (addr >> PMP_SHIFT);
+	} else if (log2len == __riscv_xlen) {
+		prot |= PMP_A_NAPOT;
+		pmpaddr = -1UL;
+	} else {
+		prot |= PMP_A_NAPOT;
+		addrmask = (1UL << (log2len - PMP_SHIFT)) - 1;
+		pmpaddr	 = ((addr >> PMP_SHIFT) & ~addrmask);
+		pmpaddr |= (addrmask >> 1);
+	}
+
+	return pmp_layout_push(layout, prot, pmpaddr);
+}
+
+/**
+ * Add an arbitrary 4-byte aligned region using the fewest entries
+ *
+ * A naturally aligned power-of-two region takes a single NAPOT entry.
+ * Anything else would need two or more NAPOT entries, so it is encoded
+ * as TOR instead: one entry when it starts where the previous TOR entry
+ * of the layout ends, otherwise one disabled entry for the base plus
+ * the TOR entry.
+ */
+int sbi_pmp_layout_add(struct sbi_pmp_layout *layout, unsigned long prot,
+		       unsigned long addr, unsigned long size)
+{
+	u32 need = 2;
+	unsigned long end = addr + size;
+	struct sbi_pmp_entry *prev;
+
+	if (!size || end < addr ||
+	    (addr & ((1UL << PMP_SHIFT) - 1)) ||
+	    (size & ((1UL << PMP_SHIFT) - 1)))
+		return SBI_EINVAL;
+
+	if (!(size & (size - 1)) && !(addr & (size - 1)))
+		return sbi_pmp_layout_add_napot(layout, prot, addr,
+						pmp_log2(size));
+
+	if (layout->count) {
+		prev = &layout->entries[layout->count - 1];
+		if ((prev->cfg & PMP_A) == PMP_A_TOR &&
+		    prev->addr == (addr >> PMP_SHIFT))
+			need = 1;
+	}
+	if (PMP_COUNT < layout->count + need)
+		return SBI_ENOSPC;
+
+	if (need == 2)
+		pmp_layout_push(layout, 0, addr >> PMP_SHIFT);
+
+	return pmp_layout_push(layout, (prot & SBI_PMP_PROT_MASK) | PMP_A_TOR,
+			       end >> PMP_SHIFT);
+}
+
+/**
+ * Add a region as a TOR pair that always takes two entries, so that it
+ * can later be moved in place with sbi_pmp_update(). An empty region
+ * adds two disabled entries.
+ */
+int sbi_pmp_layout_add_tor(struct sbi_pmp_layout *layout, unsigned long prot,
+			   unsigned long addr, unsigned long size)
+{
+	unsigned long end = addr + size;
+
+	if (end < addr || (addr & ((1UL << PMP_SHIFT) - 1)) ||
+	    (size & ((1UL << PMP_SHIFT) - 1)))
+		return SBI_EINVAL;
+	if (PMP_COUNT < layout->count + 2)
+		return SBI_ENOSPC;
+
+	pmp_layout_push(layout, 0, addr >> PMP_SHIFT);
+
+	return pmp_layout_push(layout,
+			       size ? (prot & SBI_PMP_PROT_MASK) | PMP_A_TOR : 0,
+			       end >> PMP_SHIFT);
+}
+
+/*
+ * Program the layout at entry 'first' of current HART and disable the
+ * unlocked entries from there up to 'last'
+ */
+static int pmp_program(struct sbi_scratch *scratch, u32 first, u32 last,
+		       const struct sbi_pmp_layout *layout)
+{
+	u32 i, j;
+	u8 cfg;
+	unsigned long addr, val, dirty = 0;
+	const struct sbi_pmp_entry *e;
+	struct sbi_pmp_shadow *shadow;
+
+	if (!pmp_shadow_off)
+		return SBI_ENOTSUPP;
+	if (PMP_COUNT < first || PMP_COUNT - first < layout->count)
+		return SBI_ENOSPC;
+
+	shadow = sbi_scratch_offset_ptr(scratch, pmp_shadow_off);
+
+	for (i = first; i < last; i++) {
+		if (shadow->cfg[i] & PMP_L)
+			continue;
+
+		if (i < first + layout->count) {
+			e = &layout->entries[i - first];
+			cfg = e->cfg;
+			addr = e->addr;
+		} else {
+			cfg = 0;
+			addr = shadow->addr[i];
+		}
+
+		if (addr != shadow->addr[i]) {
+			csr_write_num(CSR_PMPADDR0 + i, addr);
+			shadow->addr[i] = addr;
+		}
+		if (cfg != shadow->cfg[i]) {
+			shadow->cfg[i] = cfg;
+			dirty |= 1UL << (i / SBI_PMP_CFG_PER_CSR);
+		}
+	}
+
+	for (i = 0; dirty; i += SBI_PMP_CFG_PER_CSR, dirty >>= 1) {
+		if (!(dirty & 1UL))
+			continue;
+
+		val = 0;
+		for (j = 0; j < SBI_PMP_CFG_PER_CSR; j++)
+			val |= (unsigned long)shadow->cfg[i + j] << (j * 8);
+		csr_write_num(SBI_PMP_CFG_CSR(i), val);
+	}
+
+	return 0;
+}
+
+/**
+ * Program a layout starting at PMP entry 'first' of current HART
+ *
+ * Entries after the layout are disabled. Only the pmpaddr CSRs whose
+ * value differs from the shadow are written, and every pmpcfg CSR is
+ * written at most once. Locked entries are left untouched.
+ */
+int sbi_pmp_apply(struct sbi_scratch *scratch, u32 first,
+		  const struct sbi_pmp_layout *layout)
+{
+	return pmp_program(scratch, first, PMP_COUNT, layout);
+}
+
+/**
+ * Same as sbi_pmp_apply() but the entries after the layout are kept
+ */
+int sbi_pmp_update(struct sbi_scratch *scratch, u32 first,
+		   const struct sbi_pmp_layout *layout)
+{
+	if (PMP_COUNT < first || PMP_COUNT - first < layout->count)
+		return SBI_ENOSPC;
+
+	return pmp_program(scratch, first, first + layout->count, layout);
+}
+
+/**
+ * Record a PMP entry of current HART written outside sbi_pmp_apply(),
+ * such as by pmp_set(), so that the shadow matches the CSRs again
+ */
+void sbi_pmp_shadow_update(u32 n, unsigned long cfg, unsigned long addr)
+{
+	struct sbi_pmp_shadow *shadow;
+
+	if (!pmp_shadow_off || PMP_COUNT <= n)
+		return;
+
+	shadow = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+					pmp_shadow_off);
+	shadow->cfg[n] = cfg & 0xff;
+	shadow->addr[n] = addr;
+}
+
+/**
+ * Check whether a PMP entry of current HART that overlaps the range
+ * denies S-mode reads or writes to it
+ *
+ * This is conservative: an entry only granting access to part of the
+ * range is not taken into account.
+ */
+bool sbi_pmp_range_protected(struct sbi_scratch *scratch, unsigned long base,
+			     unsigned long size)
+{
+	u32 i;
+	unsigned long start, end, prev = 0, a, mask;
+	struct sbi_pmp_shadow *shadow;
+
+	if (!pmp_shadow_off)
+		return FALSE;
+
+	shadow = sbi_scratch_offset_ptr(scratch, pmp_shadow_off);
+
+	for (i = 0; i < PMP_COUNT; i++, prev = a) {
+		a = shadow->addr[i];
+		switch (shadow->cfg[i] & PMP_A) {
+		case PMP_A_TOR:
+			start = prev << PMP_SHIFT;
+			end = a << PMP_SHIFT;
+			break;
+		case PMP_A_NA4:
+			start = a << PMP_SHIFT;
+			end = start + (1UL << PMP_SHIFT);
+			break;
+		case PMP_A_NAPOT:
+			if (a == -1UL)
+				return (shadow->cfg[i] & (PMP_R | PMP_W)) !=
+				       (PMP_R | PMP_W);
+			mask = (a ^ (a + 1)) >> 1;
+			start = (a & ~mask) << PMP_SHIFT;
+			end = start + ((mask + 1) << (PMP_SHIFT + 1));
+			break;
+		default:
+			continue;
+		}
+
+		if (base < end && start < base + size &&
+		    (shadow->cfg[i] & (PMP_R | PMP_W)) != (PMP_R | PMP_W))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+void sbi_pmp_reserve(struct sbi_scratch *scratch, u32 count)
+{
+	struct sbi_pmp_shadow *shadow;
+
+	if (!pmp_shadow_off)
+		return;
+
+	shadow = sbi_scratch_offset_ptr(scratch, pmp_shadow_off);
+	shadow->reserved = count;
+}
+
+/**
+ * First PMP entry of current HART not reserved by the firmware, this is
+ * where enclave layouts go.
+ */
+u32 sbi_pmp_first_free(struct sbi_scratch *scratch)
+{
+	struct sbi_pmp_shadow *shadow;
+
+	if (!pmp_shadow_off)
+		return PMP_COUNT;
+
+	shadow = sbi_scratch_offset_ptr(scratch, pmp_shadow_off);
+
+	return shadow->reserved;
+}
+
+int sbi_pmp_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	u32 i, j;
+	unsigned long val = 0;
+	struct sbi_pmp_shadow *shadow;
+
+	if (cold_boot) {
+		pmp_shadow_off = sbi_scratch_alloc_offset(sizeof(*shadow),
+							  "HART_PMP_SHADOW");
+		if (!pmp_shadow_off)
+			return SBI_ENOMEM;
+	} else {
+		if (!pmp_shadow_off)
+			return SBI_ENOMEM;
+	}
+
+	shadow = sbi_scratch_offset_ptr(scratch, pmp_shadow_off);
+	shadow->reserved = 0;
+
+	for (i = 0; i < PMP_COUNT; i++) {
+		if (!(i % SBI_PMP_CFG_PER_CSR))
+			val = csr_read_num(SBI_PMP_CFG_CSR(i));
+		j = i % SBI_PMP_CFG_PER_CSR;
+		shadow->cfg[i] = (val >> (j * 8)) & 0xff;
+		shadow->addr[i] = csr_read_num(CSR_PMPADDR0 + i);
+	}
+
+	return 0;
+}
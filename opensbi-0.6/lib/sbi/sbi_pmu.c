@@ -0,0 +1,361 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+
+/*
+ * Hardware counters of the SBI PMU extension
+ *
+ * Counter indexes are CSR offsets from cycle, so S-mode reads a counter
+ * directly and the scountovf bits line up with the indexes. Programmable
+ * counters are the contiguous mhpmcounters found at boot. With Sscofpmf,
+ * they are stopped through mcountinhibit and the overflow interrupt is
+ * delegated to S-mode. Without it, stopping a programmable counter
+ * clears its event selector. The firmware times itself with mcycle, so
+ * cycle and instret are never stopped, cleared or given an initial
+ * value.
+ */
+struct sbi_pmu_hart {
+	/** Event index programmed on each counter, 0 when free */
+	u32 event[SBI_PMU_CTR_MAX];
+	/** mhpmevent value of each programmable counter */
+	u64 select[SBI_PMU_CTR_MAX];
+};
+
+struct sbi_pmu_event_map {
+	u32 eidx_start;
+	u32 eidx_end;
+	unsigned long ctr_mask;
+	u64 select;
+};
+
+static unsigned long pmu_hart_off;
+static unsigned long pmu_num_ctrs = SBI_PMU_CTR_HPM_FIRST;
+static unsigned long pmu_hpm_width = 64;
+static bool pmu_sscofpmf;
+
+static struct sbi_pmu_event_map pmu_event_map[SBI_PMU_EVENT_MAP_MAX];
+static u32 pmu_event_map_count;
+
+/* mhpmevent3..31 follow mcountinhibit in the CSR space */
+#define pmu_event_csr(cidx)	(CSR_MCOUNTINHIBIT + (cidx))
+
+static struct sbi_pmu_hart *pmu_hart(struct sbi_scratch *scratch)
+{
+	return sbi_scratch_offset_ptr(scratch, pmu_hart_off);
+}
+
+static unsigned long pmu_ctr_all_mask(void)
+{
+	if (pmu_num_ctrs == BITS_PER_LONG)
+		return -1UL;
+
+	return (1UL << pmu_num_ctrs) - 1;
+}
+
+static unsigned long pmu_ctr_hpm_mask(void)
+{
+	return pmu_ctr_all_mask() & ~((1UL << SBI_PMU_CTR_HPM_FIRST) - 1);
+}
+
+static void pmu_ctr_write(unsigned long cidx, u64 val)
+{
+#if __riscv_xlen == 32
+	csr_write_num(CSR_MCYCLE + cidx, val & 0xffffffff);
+	csr_write_num(CSR_MCYCLEH + cidx, val >> 32);
+#else
+	csr_write_num(CSR_MCYCLE + cidx, val);
+#endif
+}
+
+static void pmu_ctr_enable(struct sbi_pmu_hart *ph, unsigned long cidx,
+			   bool enable)
+{
+	if (cidx < SBI_PMU_CTR_HPM_FIRST)
+		return;
+
+	if (pmu_sscofpmf) {
+		if (enable)
+			csr_clear(CSR_MCOUNTINHIBIT, 1UL << cidx);
+		else
+			csr_set(CSR_MCOUNTINHIBIT, 1UL << cidx);
+		return;
+	}
+
+	csr_write_num(pmu_event_csr(cidx), enable ? ph->select[cidx] : 0);
+}
+
+/*
+ * Counters able to count an event, and the event selector to program.
+ * Cycles and instructions also go to the fixed counters, which cannot
+ * raise overflow interrupts. Without any platform map, HW and cache
+ * event indexes are used as the selectors themselves, which is what
+ * QEMU virt implements.
+ */
+static unsigned long pmu_event_ctrs(unsigned long event_idx, u64 event_data,
+				    u64 *select)
+{
+	u32 i;
+	unsigned long fixed = 0;
+	unsigned long type = (event_idx >> SBI_PMU_EVENT_TYPE_SHIFT) &
+			     SBI_PMU_EVENT_TYPE_MASK;
+	unsigned long code = event_idx & SBI_PMU_EVENT_CODE_MASK;
+
+	*select = 0;
+	switch (type) {
+	case SBI_PMU_EVENT_TYPE_HW:
+		if (code == SBI_PMU_HW_CPU_CYCLES)
+			fixed = 1UL << SBI_PMU_CTR_CYCLE;
+		else if (code == SBI_PMU_HW_INSTRUCTIONS)
+			fixed = 1UL << SBI_PMU_CTR_INSTRET;
+		/* fallthrough */
+	case SBI_PMU_EVENT_TYPE_CACHE:
+		for (i = 0; i < pmu_event_map_count; i++) {
+			if (event_idx < pmu_event_map[i].eidx_start ||
+			    pmu_event_map[i].eidx_end < event_idx)
+				continue;
+			*select = pmu_event_map[i].select;
+			return fixed |
+			       (pmu_event_map[i].ctr_mask & pmu_ctr_hpm_mask());
+		}
+		if (pmu_event_map_count)
+			return fixed;
+		*select = event_idx;
+		return fixed | pmu_ctr_hpm_mask();
+	case SBI_PMU_EVENT_TYPE_RAW:
+		*select = event_data & ~MHPMEVENT_SSCOF_MASK;
+		return pmu_ctr_hpm_mask();
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Let platform code route a range of event indexes to some counters
+ *
+ * Must be called from the cold boot HART before sbi_pmu_init().
+ */
+int sbi_pmu_map_event(u32 eidx_start, u32 eidx_end, unsigned long ctr_mask,
+		      u64 select)
+{
+	struct sbi_pmu_event_map *map;
+
+	if (eidx_end < eidx_start || !select)
+		return SBI_EINVAL;
+	if (pmu_event_map_count == SBI_PMU_EVENT_MAP_MAX)
+		return SBI_ENOSPC;
+
+	map = &pmu_event_map[pmu_event_map_count++];
+	map->eidx_start = eidx_start;
+	map->eidx_end = eidx_end;
+	map->ctr_mask = ctr_mask;
+	map->select = select;
+
+	return 0;
+}
+
+unsigned long sbi_pmu_num_counters(void)
+{
+	return pmu_num_ctrs;
+}
+
+int sbi_pmu_counter_info(unsigned long cidx, unsigned long *info)
+{
+	unsigned long width = 64;
+
+	if (pmu_num_ctrs <= cidx)
+		return SBI_EINVAL;
+
+	if (cidx >= SBI_PMU_CTR_HPM_FIRST)
+		width = pmu_hpm_width;
+
+	*info = (CSR_CYCLE + cidx) | ((width - 1) << 12);
+
+	return 0;
+}
+
+int sbi_pmu_counter_cfg_match(struct sbi_scratch *scratch,
+			      unsigned long cidx_base, unsigned long cidx_mask,
+			      unsigned long flags, unsigned long event_idx,
+			      u64 event_data, unsigned long *out_cidx)
+{
+	u64 select;
+	unsigned long cidx, cmask;
+	struct sbi_pmu_hart *ph = pmu_hart(scratch);
+
+	/* An event index of 0 marks a free counter */
+	if (pmu_num_ctrs <= cidx_base || !event_idx)
+		return SBI_EINVAL;
+	cmask = (cidx_mask << cidx_base) & pmu_ctr_all_mask();
+
+	if (flags & SBI_PMU_CFG_FLAG_SKIP_MATCH) {
+		if (!cmask)
+			return SBI_EINVAL;
+		cidx = __ffs(cmask);
+		if (ph->event[cidx] != event_idx)
+			return SBI_EINVAL;
+		goto configured;
+	}
+
+	cmask &= pmu_event_ctrs(event_idx, event_data, &select);
+	for (cidx = 0; cmask; cidx++, cmask >>= 1)
+		if ((cmask & 1UL) && !ph->event[cidx])
+			break;
+	if (!cmask)
+		return SBI_ENOTSUPP;
+
+	if (pmu_sscofpmf && cidx >= SBI_PMU_CTR_HPM_FIRST) {
+		csr_set(CSR_MCOUNTINHIBIT, 1UL << cidx);
+		if (flags & SBI_PMU_CFG_FLAG_SET_VUINH)
+			select |= MHPMEVENT_VUINH;
+		if (flags & SBI_PMU_CFG_FLAG_SET_VSINH)
+			select |= MHPMEVENT_VSINH;
+		if (flags & SBI_PMU_CFG_FLAG_SET_UINH)
+			select |= MHPMEVENT_UINH;
+		if (flags & SBI_PMU_CFG_FLAG_SET_SINH)
+			select |= MHPMEVENT_SINH;
+		if (flags & SBI_PMU_CFG_FLAG_SET_MINH)
+			select |= MHPMEVENT_MINH;
+	}
+
+	ph->event[cidx] = event_idx;
+	ph->select[cidx] = select;
+	if (cidx >= SBI_PMU_CTR_HPM_FIRST)
+		csr_write_num(pmu_event_csr(cidx),
+			      pmu_sscofpmf ? select : 0);
+
+configured:
+	if ((flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE) &&
+	    cidx >= SBI_PMU_CTR_HPM_FIRST)
+		pmu_ctr_write(cidx, 0);
+	if (flags & SBI_PMU_CFG_FLAG_AUTO_START)
+		pmu_ctr_enable(ph, cidx, TRUE);
+
+	*out_cidx = cidx;
+
+	return 0;
+}
+
+int sbi_pmu_counter_start(struct sbi_scratch *scratch,
+			  unsigned long cidx_base, unsigned long cidx_mask,
+			  unsigned long flags, u64 ival)
+{
+	unsigned long cidx, cmask, m;
+	struct sbi_pmu_hart *ph = pmu_hart(scratch);
+
+	if (pmu_num_ctrs <= cidx_base)
+		return SBI_EINVAL;
+	cmask = (cidx_mask << cidx_base) & pmu_ctr_all_mask();
+
+	/* Check the whole set first, so that nothing is started on error */
+	for (cidx = 0, m = cmask; m; cidx++, m >>= 1) {
+		if (!(m & 1UL))
+			continue;
+		if (!ph->event[cidx])
+			return SBI_EINVAL;
+		if ((flags & SBI_PMU_START_FLAG_SET_INIT_VALUE) &&
+		    cidx < SBI_PMU_CTR_HPM_FIRST)
+			return SBI_EINVAL;
+	}
+
+	for (cidx = 0; cmask; cidx++, cmask >>= 1) {
+		if (!(cmask & 1UL))
+			continue;
+
+		if (flags & SBI_PMU_START_FLAG_SET_INIT_VALUE)
+			pmu_ctr_write(cidx, ival);
+		/* Rewriting the selector also clears its overflow bit */
+		if (pmu_sscofpmf && cidx >= SBI_PMU_CTR_HPM_FIRST)
+			csr_write_num(pmu_event_csr(cidx),
+				      ph->select[cidx]);
+		pmu_ctr_enable(ph, cidx, TRUE);
+	}
+
+	return 0;
+}
+
+int sbi_pmu_counter_stop(struct sbi_scratch *scratch,
+			 unsigned long cidx_base, unsigned long cidx_mask,
+			 unsigned long flags)
+{
+	unsigned long cidx, cmask;
+	struct sbi_pmu_hart *ph = pmu_hart(scratch);
+
+	if (pmu_num_ctrs <= cidx_base)
+		return SBI_EINVAL;
+	cmask = (cidx_mask << cidx_base) & pmu_ctr_all_mask();
+
+	for (cidx = 0; cmask; cidx++, cmask >>= 1) {
+		if (!(cmask & 1UL))
+			continue;
+		if (!ph->event[cidx])
+			return SBI_EINVAL;
+
+		pmu_ctr_enable(ph, cidx, FALSE);
+		if (!(flags & SBI_PMU_STOP_FLAG_RESET))
+			continue;
+
+		ph->event[cidx] = 0;
+		ph->select[cidx] = 0;
+		if (cidx >= SBI_PMU_CTR_HPM_FIRST)
+			csr_write_num(pmu_event_csr(cidx), 0);
+	}
+
+	return 0;
+}
+
+/* Programmable counters read back what was written, absent ones read 0 */
+static void pmu_detect(void)
+{
+	unsigned long i;
+
+	for (i = SBI_PMU_CTR_HPM_FIRST; i < SBI_PMU_CTR_MAX; i++) {
+		csr_write_num(pmu_event_csr(i), 0);
+		csr_write_num(CSR_MCYCLE + i, 1);
+		if (!csr_read_num(CSR_MCYCLE + i))
+			break;
+#if __riscv_xlen == 64
+		csr_write_num(CSR_MCYCLE + i, -1UL);
+		pmu_hpm_width = __fls(csr_read_num(CSR_MCYCLE + i)) + 1;
+#endif
+		csr_write_num(CSR_MCYCLE + i, 0);
+	}
+	pmu_num_ctrs = i;
+
+#if __riscv_xlen == 64
+	/* Only writable with Sscofpmf, whose overflow bits need RV64 here */
+	csr_set(CSR_MIDELEG, MIP_LCOFIP);
+	pmu_sscofpmf = (csr_read(CSR_MIDELEG) & MIP_LCOFIP) ? TRUE : FALSE;
+#endif
+}
+
+int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		pmu_hart_off = sbi_scratch_alloc_offset(
+					sizeof(struct sbi_pmu_hart), "PMU");
+		if (!pmu_hart_off)
+			return SBI_ENOMEM;
+		pmu_detect();
+	} else if (!pmu_hart_off) {
+		return SBI_ENOMEM;
+	}
+
+	sbi_memset(pmu_hart(scratch), 0, sizeof(struct sbi_pmu_hart));
+
+	/* Programmable counters stay stopped until configured */
+	if (pmu_sscofpmf) {
+		csr_set(CSR_MIDELEG, MIP_LCOFIP);
+		csr_write(CSR_MCOUNTINHIBIT, pmu_ctr_hpm_mask());
+	}
+
+	return 0;
+}
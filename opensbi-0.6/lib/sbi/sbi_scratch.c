@@ -8,44 +8,157 @@
  */
 
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 
+/* clang-format off */
+
+#define SCRATCH_LINE_COUNT	(SBI_SCRATCH_SIZE / SBI_SCRATCH_CACHELINE_SIZE)
+#define SCRATCH_LINE_FIRST	((SBI_SCRATCH_EXTRA_SPACE_OFFSET + \
+				  SBI_SCRATCH_CACHELINE_SIZE - 1) / \
+				 SBI_SCRATCH_CACHELINE_SIZE)
+#define SCRATCH_CLASS_COUNT	3
+#define SCRATCH_CLASS_MAX_SIZE	(8UL << (SCRATCH_CLASS_COUNT - 1))
+#define SCRATCH_ALLOC_MAX	64
+
+/* clang-format on */
+
+/** Record of one allocation, used for free-ing and for the dump */
+struct scratch_alloc {
+	unsigned long offset;
+	unsigned long size;
+	const char *owner;
+};
+
 static spinlock_t extra_lock = SPIN_LOCK_INITIALIZER;
-static unsigned long extra_offset = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
 
-unsigned long sbi_scratch_alloc_offset(unsigned long size, const char *owner)
+/*
+ * The extra space is managed in cachelines. A line is either free, part
+ * of a run handed out whole, or split into equal slots of one small size
+ * class (8, 16 or 32 bytes). The offsets are the same on every HART so
+ * the bookkeeping is global while the memory itself is per-HART.
+ */
+static u64 line_used;
+static u8 line_class[SCRATCH_LINE_COUNT];
+static u8 line_slots[SCRATCH_LINE_COUNT];
+static struct scratch_alloc allocs[SCRATCH_ALLOC_MAX];
+static u32 alloc_count;
+
+static void scratch_lines_mark(u32 first, u32 count, bool used)
 {
 	u32 i;
+
+	for (i = first; i < first + count; i++) {
+		if (used)
+			line_used |= 1ULL << i;
+		else
+			line_used &= ~(1ULL << i);
+	}
+}
+
+static unsigned long scratch_lines_alloc(u32 count)
+{
+	u32 i, run = 0;
+
+	for (i = SCRATCH_LINE_FIRST; i < SCRATCH_LINE_COUNT; i++) {
+		if (line_used & (1ULL << i)) {
+			run = 0;
+			continue;
+		}
+		if (++run < count)
+			continue;
+
+		scratch_lines_mark(i + 1 - count, count, TRUE);
+		return (i + 1 - count) * SBI_SCRATCH_CACHELINE_SIZE;
+	}
+
+	return 0;
+}
+
+static unsigned long scratch_slot_alloc(u32 class)
+{
+	u32 i, slot, slots = SBI_SCRATCH_CACHELINE_SIZE / (8UL << class);
+	unsigned long line;
+
+	for (i = SCRATCH_LINE_FIRST; i < SCRATCH_LINE_COUNT; i++) {
+		if (line_class[i] != class + 1)
+			continue;
+		for (slot = 0; slot < slots; slot++) {
+			if (line_slots[i] & (1U << slot))
+				continue;
+			line_slots[i] |= 1U << slot;
+			return i * SBI_SCRATCH_CACHELINE_SIZE +
+			       slot * (8UL << class);
+		}
+	}
+
+	line = scratch_lines_alloc(1);
+	if (!line)
+		return 0;
+
+	i = line / SBI_SCRATCH_CACHELINE_SIZE;
+	line_class[i] = class + 1;
+	line_slots[i] = 1;
+
+	return line;
+}
+
+static void scratch_release(unsigned long offset, unsigned long size)
+{
+	u32 i = offset / SBI_SCRATCH_CACHELINE_SIZE;
+	u32 slot;
+
+	if (!line_class[i]) {
+		scratch_lines_mark(i, size / SBI_SCRATCH_CACHELINE_SIZE, FALSE);
+		return;
+	}
+
+	slot = (offset % SBI_SCRATCH_CACHELINE_SIZE) /
+	       (8UL << (line_class[i] - 1));
+	line_slots[i] &= ~(1U << slot);
+	if (!line_slots[i]) {
+		line_class[i] = 0;
+		scratch_lines_mark(i, 1, FALSE);
+	}
+}
+
+static unsigned long scratch_alloc(unsigned long size, const char *owner,
+				   bool cacheline)
+{
+	u32 i, class = 0;
 	void *ptr;
 	unsigned long ret = 0;
 	struct sbi_scratch *scratch, *rscratch;
 	const struct sbi_platform *plat;
 
-	/*
-	 * We have a simple brain-dead allocator which never expects
-	 * anything to be free-ed hence it keeps incrementing the
-	 * next allocation offset until it runs-out of space.
-	 *
-	 * In future, we will have more sophisticated allocator which
-	 * will allow us to re-claim free-ed space.
-	 */
-
-	if (!size)
+	if (!size || SBI_SCRATCH_SIZE < size)
 		return 0;
 
-	if (size & (__SIZEOF_POINTER__ - 1))
-		size = (size & ~(__SIZEOF_POINTER__ - 1)) + __SIZEOF_POINTER__;
-
 	spin_lock(&extra_lock);
 
-	if (SBI_SCRATCH_SIZE < (extra_offset + size))
+	if (SCRATCH_ALLOC_MAX <= alloc_count)
+		goto done;
+
+	if (!cacheline && size <= SCRATCH_CLASS_MAX_SIZE) {
+		while ((8UL << class) < size)
+			class++;
+		size = 8UL << class;
+		ret = scratch_slot_alloc(class);
+	} else {
+		size = (size + SBI_SCRATCH_CACHELINE_SIZE - 1) &
+		       ~(SBI_SCRATCH_CACHELINE_SIZE - 1);
+		ret = scratch_lines_alloc(size / SBI_SCRATCH_CACHELINE_SIZE);
+	}
+	if (!ret)
 		goto done;
 
-	ret = extra_offset;
-	extra_offset += size;
+	allocs[alloc_count].offset = ret;
+	allocs[alloc_count].size = size;
+	allocs[alloc_count].owner = owner;
+	alloc_count++;
 
 done:
 	spin_unlock(&extra_lock);
@@ -63,14 +176,49 @@ done:
 	return ret;
 }
 
+unsigned long sbi_scratch_alloc_offset(unsigned long size, const char *owner)
+{
+	return scratch_alloc(size, owner, FALSE);
+}
+
+unsigned long sbi_scratch_alloc_cacheline_offset(unsigned long size,
+						 const char *owner)
+{
+	return scratch_alloc(size, owner, TRUE);
+}
+
 void sbi_scratch_free_offset(unsigned long offset)
 {
+	u32 i;
+
 	if ((offset < SBI_SCRATCH_EXTRA_SPACE_OFFSET) ||
 	    (SBI_SCRATCH_SIZE <= offset))
 		return;
 
-	/*
-	 * We don't actually free-up because it's a simple
-	 * brain-dead allocator.
-	 */
+	spin_lock(&extra_lock);
+
+	for (i = 0; i < alloc_count; i++) {
+		if (allocs[i].offset != offset)
+			continue;
+
+		scratch_release(offset, allocs[i].size);
+		allocs[i] = allocs[--alloc_count];
+		break;
+	}
+
+	spin_unlock(&extra_lock);
+}
+
+void sbi_scratch_alloc_dump(void)
+{
+	u32 i;
+
+	spin_lock(&extra_lock);
+
+	for (i = 0; i < alloc_count; i++)
+		sbi_printf("SCRATCH : 0x%04lx-0x%04lx %s\n", allocs[i].offset,
+			   allocs[i].offset + allocs[i].size - 1,
+			   allocs[i].owner ? allocs[i].owner : "(null)");
+
+	spin_unlock(&extra_lock);
 }
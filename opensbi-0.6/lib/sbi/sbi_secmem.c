@@ -0,0 +1,305 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_hsm.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_penglai_shm.h>
+#include <sbi/sbi_penglai_sm.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmp.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_secmem.h>
+#include <sbi/sbi_trace.h>
+
+/*
+ * Reserve of host donated memory waiting to be handed to the enclave
+ * monitor. It is a single contiguous range, so that a TOR pair of PMP
+ * entries on every HART keeps the host out of it. Chunks go to the SM
+ * from the bottom of the range and back to the host from the top, and
+ * donations must extend the range at either end.
+ */
+static spinlock_t secmem_lock = SPIN_LOCK_INITIALIZER;
+static unsigned long secmem_base;
+static volatile unsigned long secmem_free;
+
+/* Range the PMP entries are programmed with, and its generation */
+static volatile unsigned long secmem_pmp_base;
+static volatile unsigned long secmem_pmp_size;
+static volatile unsigned long secmem_pmp_gen;
+
+/* Per-HART generation of the range its PMP entries match */
+static unsigned long secmem_gen_off;
+static u32 secmem_pmp_event = SBI_IPI_EVENT_MAX;
+
+static void secmem_pmp_program(struct sbi_scratch *scratch)
+{
+	unsigned long *gen = sbi_scratch_offset_ptr(scratch, secmem_gen_off);
+	unsigned long g = secmem_pmp_gen;
+	struct sbi_pmp_layout layout;
+
+	smp_rmb();
+	sbi_pmp_layout_init(&layout);
+	sbi_pmp_layout_add_tor(&layout, 0, secmem_pmp_base, secmem_pmp_size);
+	sbi_pmp_update(scratch, SBI_SECMEM_PMP_ENTRY, &layout);
+	__asm__ __volatile__("sfence.vma" : : : "memory");
+
+	smp_wmb();
+	*gen = g;
+}
+
+static struct sbi_ipi_event_ops secmem_pmp_ops = {
+	.name = "IPI_SECMEM_PMP",
+	.process = secmem_pmp_program,
+};
+
+/*
+ * Move the PMP entries of every running HART to the current reserve.
+ * Other HARTs are only waited for when wait is set, that is when memory
+ * leaves the reserve for the host; a HART still denying access to a
+ * chunk the SM already owns is harmless.
+ */
+static int secmem_pmp_sync(bool wait)
+{
+	u32 i;
+	ulong hmask = 0;
+	unsigned long *gen, spins = 0;
+	struct sbi_scratch *rscratch, *scratch = sbi_scratch_thishart_ptr();
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+	u32 count = sbi_platform_hart_count(plat), hartid = sbi_current_hartid();
+
+	secmem_pmp_base = secmem_base;
+	secmem_pmp_size = secmem_free;
+	smp_wmb();
+	secmem_pmp_gen++;
+
+	secmem_pmp_program(scratch);
+
+	if (BITS_PER_LONG < count)
+		count = BITS_PER_LONG;
+	for (i = 0; i < count; i++)
+		if (i != hartid &&
+		    sbi_hsm_hart_get_state(i) == SBI_HART_STARTED)
+			hmask |= 1UL << i;
+	if (!hmask)
+		return 0;
+
+	sbi_ipi_send_many(scratch, hmask, 0, secmem_pmp_event, NULL);
+	if (!wait)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		if (!(hmask & (1UL << i)))
+			continue;
+		rscratch = sbi_hart_id_to_scratch(scratch, i);
+		gen = sbi_scratch_offset_ptr(rscratch, secmem_gen_off);
+		while (*(volatile unsigned long *)gen != secmem_pmp_gen) {
+			if (SBI_SECMEM_PMP_WAIT_SPINS < ++spins)
+				return SBI_ETIMEDOUT;
+			cpu_relax();
+		}
+	}
+
+	return 0;
+}
+
+static bool secmem_overlaps(unsigned long base, unsigned long size)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	if (base < scratch->fw_start + scratch->fw_size &&
+	    scratch->fw_start < base + size)
+		return TRUE;
+
+	if (secmem_free && base < secmem_base + secmem_free &&
+	    secmem_base < base + size)
+		return TRUE;
+
+	return check_mem_overlap(base, size) ? TRUE : FALSE;
+}
+
+static int secmem_add(unsigned long base, unsigned long size)
+{
+	int rc = 0;
+
+	spin_lock(&secmem_lock);
+
+	if (secmem_overlaps(base, size)) {
+		rc = SBI_DENIED;
+		goto done;
+	}
+
+	if (!secmem_free)
+		secmem_base = base;
+	else if (base + size == secmem_base)
+		secmem_base = base;
+	else if (base != secmem_base + secmem_free) {
+		rc = SBI_EINVAL;
+		goto done;
+	}
+	secmem_free += size;
+
+	rc = secmem_pmp_sync(FALSE);
+
+done:
+	spin_unlock(&secmem_lock);
+
+	return rc;
+}
+
+static int secmem_add_unshared(unsigned long base, unsigned long size)
+{
+	return sbi_penglai_shm_exclude(base, size, secmem_add);
+}
+
+/**
+ * Add host donated memory to the reserve
+ *
+ * Both base and size must be multiples of SBI_SECMEM_CHUNK_SIZE and the
+ * range must start or end at the reserve, unless the reserve is empty.
+ * Anything else is refused with SBI_EINVAL and is for the SM to take.
+ * The range must not overlap the firmware, secure memory, the reserve,
+ * a shared region or a trace buffer.
+ */
+int sbi_secmem_donate(unsigned long base, unsigned long size)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	/* Without PMP the reserve could not be kept from the host */
+	if (!sbi_platform_has_pmp(sbi_platform_ptr(scratch)) || !size ||
+	    ((base | size) & (SBI_SECMEM_CHUNK_SIZE - 1)) ||
+	    base + size < base)
+		return SBI_EINVAL;
+
+	return sbi_trace_exclude(scratch, base, size, secmem_add_unshared);
+}
+
+/**
+ * Take a block of at least size bytes out of the reserve
+ *
+ * Returns the base of the block or zero if not enough is free.
+ */
+unsigned long sbi_secmem_take(unsigned long size)
+{
+	unsigned long base = 0;
+
+	size = (size + SBI_SECMEM_CHUNK_SIZE - 1) &
+	       ~(SBI_SECMEM_CHUNK_SIZE - 1);
+	if (!size)
+		return 0;
+
+	spin_lock(&secmem_lock);
+
+	if (secmem_free < size)
+		goto done;
+
+	base = secmem_base;
+	secmem_base += size;
+	secmem_free -= size;
+	secmem_pmp_sync(FALSE);
+
+done:
+	spin_unlock(&secmem_lock);
+
+	return base;
+}
+
+/**
+ * Give size bytes from the top of the reserve back to the host
+ *
+ * This only succeeds while the reserve stays above the high watermark.
+ * The memory is returned once no HART denies the host access to it.
+ */
+int sbi_secmem_reclaim(unsigned long size, unsigned long *base)
+{
+	int rc = SBI_ENOMEM;
+
+	if (!base || !size || (size & (SBI_SECMEM_CHUNK_SIZE - 1)))
+		return SBI_EINVAL;
+
+	spin_lock(&secmem_lock);
+
+	if (secmem_free < SBI_SECMEM_HIGH_WATERMARK + size)
+		goto done;
+
+	secmem_free -= size;
+	rc = secmem_pmp_sync(TRUE);
+	if (rc) {
+		/* Some HART may still deny it, keep it in the reserve */
+		secmem_free += size;
+		secmem_pmp_sync(FALSE);
+		goto done;
+	}
+	*base = secmem_base + secmem_free;
+
+done:
+	spin_unlock(&secmem_lock);
+
+	return rc;
+}
+
+bool sbi_secmem_overlaps_reserve(unsigned long base, unsigned long size)
+{
+	bool ret;
+
+	spin_lock(&secmem_lock);
+	ret = secmem_free && base < secmem_base + secmem_free &&
+	      secmem_base < base + size;
+	spin_unlock(&secmem_lock);
+
+	return ret;
+}
+
+unsigned long sbi_secmem_free_bytes(void)
+{
+	return secmem_free;
+}
+
+bool sbi_secmem_below_low_watermark(void)
+{
+	return secmem_free < SBI_SECMEM_LOW_WATERMARK;
+}
+
+/**
+ * Add the PMP entries guarding the reserve, which must land at entry
+ * SBI_SECMEM_PMP_ENTRY, to the firmware layout of a HART
+ */
+int sbi_secmem_pmp_layout(struct sbi_pmp_layout *layout)
+{
+	if (layout->count != SBI_SECMEM_PMP_ENTRY)
+		return SBI_EINVAL;
+
+	return sbi_pmp_layout_add_tor(layout, 0, secmem_pmp_base,
+				      secmem_pmp_size);
+}
+
+int sbi_secmem_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	int ret;
+	unsigned long *gen;
+
+	if (cold_boot) {
+		secmem_gen_off = sbi_scratch_alloc_offset(sizeof(*gen),
+							  "SECMEM_PMP_GEN");
+		if (!secmem_gen_off)
+			return SBI_ENOMEM;
+
+		ret = sbi_ipi_event_create(&secmem_pmp_ops);
+		if (ret < 0)
+			return ret;
+		secmem_pmp_event = ret;
+	} else {
+		if (!secmem_gen_off || secmem_pmp_event == SBI_IPI_EVENT_MAX)
+			return SBI_ENOMEM;
+	}
+
+	/* The entries were programmed by sbi_hart_init() */
+	gen = sbi_scratch_offset_ptr(scratch, secmem_gen_off);
+	*gen = secmem_pmp_gen;
+
+	return 0;
+}
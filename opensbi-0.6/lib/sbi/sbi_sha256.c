@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/sbi_sha256.h>
+#include <sbi/sbi_string.h>
+
+static const u32 sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(struct sbi_sha256_ctx *ctx, const u8 *p)
+{
+	u32 w[64], a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((u32)p[4 * i] << 24) | ((u32)p[4 * i + 1] << 16) |
+		       ((u32)p[4 * i + 2] << 8) | p[4 * i + 3];
+	for (; i < 64; i++)
+		w[i] = (ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^
+			(w[i - 2] >> 10)) + w[i - 7] +
+		       (ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^
+			(w[i - 15] >> 3)) + w[i - 16];
+
+	a = ctx->state[0];
+	b = ctx->state[1];
+	c = ctx->state[2];
+	d = ctx->state[3];
+	e = ctx->state[4];
+	f = ctx->state[5];
+	g = ctx->state[6];
+	h = ctx->state[7];
+
+	for (i = 0; i < 64; i++) {
+		t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+		     ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+		     ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	ctx->state[0] += a;
+	ctx->state[1] += b;
+	ctx->state[2] += c;
+	ctx->state[3] += d;
+	ctx->state[4] += e;
+	ctx->state[5] += f;
+	ctx->state[6] += g;
+	ctx->state[7] += h;
+}
+
+void sbi_sha256_init(struct sbi_sha256_ctx *ctx)
+{
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+	ctx->count = 0;
+}
+
+void sbi_sha256_update(struct sbi_sha256_ctx *ctx, const void *data,
+		       unsigned long len)
+{
+	const u8 *p = data;
+	unsigned long fill = ctx->count % SBI_SHA256_BLOCK_SIZE;
+	unsigned long n;
+
+	ctx->count += len;
+
+	if (fill) {
+		n = SBI_SHA256_BLOCK_SIZE - fill;
+		if (len < n) {
+			sbi_memcpy(ctx->buf + fill, p, len);
+			return;
+		}
+		sbi_memcpy(ctx->buf + fill, p, n);
+		sha256_block(ctx, ctx->buf);
+		p += n;
+		len -= n;
+	}
+
+	for (; SBI_SHA256_BLOCK_SIZE <= len; len -= SBI_SHA256_BLOCK_SIZE) {
+		sha256_block(ctx, p);
+		p += SBI_SHA256_BLOCK_SIZE;
+	}
+
+	if (len)
+		sbi_memcpy(ctx->buf, p, len);
+}
+
+void sbi_sha256_final(struct sbi_sha256_ctx *ctx, u8 *digest)
+{
+	u64 bits = ctx->count * 8;
+	unsigned long fill = ctx->count % SBI_SHA256_BLOCK_SIZE;
+	int i;
+
+	ctx->buf[fill++] = 0x80;
+	if (SBI_SHA256_BLOCK_SIZE - 8 < fill) {
+		sbi_memset(ctx->buf + fill, 0, SBI_SHA256_BLOCK_SIZE - fill);
+		sha256_block(ctx, ctx->buf);
+		fill = 0;
+	}
+	sbi_memset(ctx->buf + fill, 0, SBI_SHA256_BLOCK_SIZE - 8 - fill);
+	for (i = 0; i < 8; i++)
+		ctx->buf[SBI_SHA256_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+	sha256_block(ctx, ctx->buf);
+
+	for (i = 0; i < 8; i++) {
+		digest[4 * i] = ctx->state[i] >> 24;
+		digest[4 * i + 1] = ctx->state[i] >> 16;
+		digest[4 * i + 2] = ctx->state[i] >> 8;
+		digest[4 * i + 3] = ctx->state[i];
+	}
+}
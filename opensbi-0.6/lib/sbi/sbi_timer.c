@@ -9,6 +9,7 @@
 
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_timer.h>
@@ -87,6 +88,9 @@ void sbi_timer_process(struct sbi_scratch *scratch)
 {
 	csr_clear(CSR_MIE, MIP_MTIP);
 	csr_set(CSR_MIP, MIP_STIP);
+
+	/* Timer ticks are a good time for leftover console output */
+	sbi_console_drain();
 }
 
 int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
@@ -17,16 +17,175 @@
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_hfence.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_platform.h>
 
 static unsigned long tlb_sync_off;
-static unsigned long tlb_fifo_off;
-static unsigned long tlb_fifo_mem_off;
+static unsigned long tlb_ticket_off;
+static unsigned long tlb_ring_off;
 static unsigned long tlb_range_flush_limit;
 
+/*
+ * Each HART owns a bounded multi-producer single-consumer ring of TLB
+ * requests. Remote HARTs claim a position by advancing the head with
+ * cmpxchg and publish the slot by storing a generation tag (position + 1)
+ * into it. The owner HART consumes in order and recycles a slot by storing
+ * the position of its next lap. A slot tagged with SBI_TLB_SLOT_BUSY is
+ * being read by the owner or coalesced by a producer, which gives both
+ * sides exclusive access to the payload without any lock.
+ */
+#define SBI_TLB_RING_MASK		(SBI_TLB_RING_NUM_ENTRIES - 1)
+#define SBI_TLB_SLOT_BUSY		(-1UL)
+#define SBI_TLB_RING_PAD		((64 / __SIZEOF_POINTER__) - 1)
+
+/*
+ * Completion of synchronous requests. The source HART counts the remote
+ * HARTs it queued work on in 'pending' and waits, once for the whole
+ * set, until as many of them have bumped 'acked'.
+ */
+struct sbi_tlb_sync {
+	/** Number of acks received from remote HARTs */
+	volatile unsigned long acked;
+	/** Number of acks expected by this HART (written only by owner) */
+	unsigned long pending;
+};
+
+/*
+ * Completion tickets of asynchronous requests. Every request of a source
+ * HART gets the next sequence number and the slot it maps to, in which
+ * each target HART clears its bit of 'pending' after flushing. A ticket
+ * is the sequence number above the source HART ID. A slot is only reused
+ * once its previous request completed, so a ticket whose slot moved on
+ * is complete as well.
+ */
+struct sbi_tlb_ticket {
+	/** Sequence number of the last request sent (written only by owner) */
+	volatile unsigned long seq;
+	/** Sequence number of the request in each slot */
+	volatile unsigned long slot_seq[SBI_TLB_TICKET_SLOTS];
+	/** Target HARTs of each slot which have not flushed yet */
+	volatile unsigned long pending[SBI_TLB_TICKET_SLOTS];
+	/** Set while an asynchronous request is being sent */
+	unsigned long async;
+};
+
+#define SBI_TLB_TICKET_SLOT(seq)	((seq) & (SBI_TLB_TICKET_SLOTS - 1))
+
+struct sbi_tlb_slot {
+	/** Generation tag of the slot */
+	volatile unsigned long seq;
+	/** TLB request payload */
+	struct sbi_tlb_info info;
+};
+
+struct sbi_tlb_ring {
+	/** Next position to be claimed by producers */
+	volatile unsigned long head;
+	unsigned long head_pad[SBI_TLB_RING_PAD];
+	/** Next position to be consumed by the owner HART */
+	volatile unsigned long tail;
+	unsigned long tail_pad[SBI_TLB_RING_PAD];
+	/** Ring slots */
+	struct sbi_tlb_slot slots[SBI_TLB_RING_NUM_ENTRIES];
+};
+
+static void sbi_tlb_ring_init(struct sbi_tlb_ring *ring)
+{
+	unsigned long i;
+
+	ring->head = 0;
+	ring->tail = 0;
+	for (i = 0; i < SBI_TLB_RING_NUM_ENTRIES; i++)
+		ring->slots[i].seq = i;
+}
+
+/* Note: must be called only by the HART owning the ring */
+static int sbi_tlb_ring_dequeue(struct sbi_tlb_ring *ring,
+				struct sbi_tlb_info *tinfo)
+{
+	unsigned long seq, pos = ring->tail;
+	struct sbi_tlb_slot *slot = &ring->slots[pos & SBI_TLB_RING_MASK];
+
+	while (1) {
+		seq = atomic_raw_cmpxchg_ulong(&slot->seq, pos + 1,
+					       SBI_TLB_SLOT_BUSY);
+		if (seq == pos + 1)
+			break;
+		/* Empty or claimed by a producer but not yet published */
+		if (seq != SBI_TLB_SLOT_BUSY)
+			return SBI_ENOENT;
+		cpu_relax();
+	}
+
+	sbi_memcpy(tinfo, &slot->info, SBI_TLB_INFO_SIZE);
+	ring->tail = pos + 1;
+	__smp_store_release(&slot->seq, pos + SBI_TLB_RING_NUM_ENTRIES);
+
+	return 0;
+}
+
+static int sbi_tlb_ring_enqueue(struct sbi_tlb_ring *ring,
+				struct sbi_tlb_info *tinfo)
+{
+	unsigned long seq, pos = ring->head;
+	struct sbi_tlb_slot *slot;
+
+	while (1) {
+		slot = &ring->slots[pos & SBI_TLB_RING_MASK];
+		seq = __smp_load_acquire(&slot->seq);
+		if (seq == pos) {
+			if (atomic_raw_cmpxchg_ulong(&ring->head,
+						     pos, pos + 1) == pos)
+				break;
+			pos = ring->head;
+		} else if (seq == SBI_TLB_SLOT_BUSY || (long)(seq - pos) < 0) {
+			/* Slot still holds an entry of the previous lap */
+			return SBI_ENOSPC;
+		} else {
+			/* Another producer claimed this position */
+			pos = ring->head;
+		}
+	}
+
+	sbi_memcpy(&slot->info, tinfo, SBI_TLB_INFO_SIZE);
+	__smp_store_release(&slot->seq, pos + 1);
+
+	return 0;
+}
+
+/**
+ * Try to merge a request into one of the published entries of a ring.
+ * The callback is invoked with exclusive access to the entry.
+ */
+static int sbi_tlb_ring_coalesce(struct sbi_tlb_ring *ring,
+				 struct sbi_tlb_info *tinfo,
+				 int (*fptr)(void *in, void *data))
+{
+	unsigned long pos, head;
+	struct sbi_tlb_slot *slot;
+	int ret;
+
+	head = __smp_load_acquire(&ring->head);
+	for (pos = ring->tail; (long)(head - pos) > 0; pos++) {
+		slot = &ring->slots[pos & SBI_TLB_RING_MASK];
+		if (slot->seq != pos + 1)
+			continue;
+		if (atomic_raw_cmpxchg_ulong(&slot->seq, pos + 1,
+					     SBI_TLB_SLOT_BUSY) != pos + 1)
+			continue;
+
+		ret = fptr(tinfo, &slot->info);
+		__smp_store_release(&slot->seq, pos + 1);
+		if (ret == SBI_FIFO_SKIP || ret == SBI_FIFO_UPDATED)
+			return ret;
+	}
+
+	return SBI_FIFO_UNCHANGED;
+}
+
 static void sbi_tlb_flush_all(void)
 {
 	__asm__ __volatile("sfence.vma");
@@ -187,14 +346,27 @@ static void sbi_tlb_local_flush(struct sbi_tlb_info *tinfo)
 	return;
 }
 
+static void sbi_tlb_ack(volatile unsigned long *counter)
+{
+	unsigned long old;
+
+	do {
+		old = *counter;
+	} while (atomic_raw_cmpxchg_ulong(counter, old, old + 1) != old);
+}
+
 static void sbi_tlb_entry_process(struct sbi_scratch *scratch,
 				  struct sbi_tlb_info *tinfo)
 {
 	u32 i;
 	u64 m;
 	struct sbi_scratch *rscratch = NULL;
-	unsigned long *rtlb_sync = NULL;
+	struct sbi_tlb_sync *rtlb_sync = NULL;
+	struct sbi_tlb_ticket *rticket = NULL;
+	unsigned long seq;
 
+	sbi_trace(scratch, SBI_TRACE_TLB_FLUSH, tinfo->type,
+		  tinfo->start, tinfo->size);
 	sbi_tlb_local_flush(tinfo);
 	for (i = 0, m = tinfo->shart_mask; m; i++, m >>= 1) {
 		if (!(m & 1UL))
@@ -202,18 +374,28 @@ static void sbi_tlb_entry_process(struct sbi_scratch *scratch,
 
 		rscratch = sbi_hart_id_to_scratch(scratch, i);
 		rtlb_sync = sbi_scratch_offset_ptr(rscratch, tlb_sync_off);
-		while (atomic_raw_xchg_ulong(rtlb_sync, 1)) ;
+		sbi_tlb_ack(&rtlb_sync->acked);
 	}
+
+	if (!tinfo->ticket)
+		return;
+
+	seq = tinfo->ticket >> SBI_TLB_TICKET_HART_BITS;
+	rscratch = sbi_hart_id_to_scratch(scratch,
+				tinfo->ticket & SBI_TLB_TICKET_HART_MASK);
+	rticket = sbi_scratch_offset_ptr(rscratch, tlb_ticket_off);
+	atomic_raw_clear_bit(sbi_current_hartid(),
+			     &rticket->pending[SBI_TLB_TICKET_SLOT(seq)]);
 }
 
 static void sbi_tlb_process_count(struct sbi_scratch *scratch, int count)
 {
 	struct sbi_tlb_info tinfo;
 	u32 deq_count = 0;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	struct sbi_tlb_ring *tlb_ring =
+			sbi_scratch_offset_ptr(scratch, tlb_ring_off);
 
-	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo)) {
+	while (!sbi_tlb_ring_dequeue(tlb_ring, &tinfo)) {
 		sbi_tlb_entry_process(scratch, &tinfo);
 		deq_count++;
 		if (deq_count > count)
@@ -225,26 +407,36 @@ static void sbi_tlb_process_count(struct sbi_scratch *scratch, int count)
 static void sbi_tlb_process(struct sbi_scratch *scratch)
 {
 	struct sbi_tlb_info tinfo;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	struct sbi_tlb_ring *tlb_ring =
+			sbi_scratch_offset_ptr(scratch, tlb_ring_off);
 
-	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo))
+	while (!sbi_tlb_ring_dequeue(tlb_ring, &tinfo))
 		sbi_tlb_entry_process(scratch, &tinfo);
 }
 
 static void sbi_tlb_sync(struct sbi_scratch *scratch)
 {
-	unsigned long *tlb_sync =
+	struct sbi_tlb_sync *tlb_sync =
 			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	struct sbi_tlb_ticket *tlb_ticket =
+			sbi_scratch_offset_ptr(scratch, tlb_ticket_off);
+
+	/* Asynchronous requests are completed through tickets */
+	if (tlb_ticket->async)
+		return;
 
-	while (!atomic_raw_xchg_ulong(tlb_sync, 0)) {
+	while (tlb_sync->acked != tlb_sync->pending) {
 		/*
-		 * While we are waiting for remote hart to set the sync,
-		 * consume fifo requests to avoid deadlock.
+		 * While we are waiting for remote harts to ack,
+		 * consume ring requests to avoid deadlock.
 		 */
 		sbi_tlb_process_count(scratch, 1);
 	}
 
+	/* All the acks are in, nobody else touches the counters now */
+	tlb_sync->acked = 0;
+	tlb_sync->pending = 0;
+
 	return;
 }
 
@@ -274,20 +466,20 @@ static inline int __sbi_tlb_range_check(struct sbi_tlb_info *curr,
 }
 
 /**
- * Call back to decide if an inplace fifo update is required or next entry can
+ * Call back to decide if an inplace ring update is required or next entry can
  * can be skipped. Here are the different cases that are being handled.
  *
  * Case1:
  *	if next flush request range lies within one of the existing entry, skip
  *	the next entry.
  * Case2:
- *	if flush request range in current fifo entry lies within next flush
+ *	if flush request range in current ring entry lies within next flush
  *	request, update the current entry.
  *
  * Note:
- *	We can not issue a fifo reset anymore if a complete vma flush is requested.
+ *	We can not issue a ring reset anymore if a complete vma flush is requested.
  *	This is because we are queueing FENCE.I requests as well now.
- *	To ease up the pressure in enqueue/fifo sync path, try to dequeue 1 element
+ *	To ease up the pressure in enqueue/ring sync path, try to dequeue 1 element
  *	before continuing the while loop. This method is preferred over wfi/ipi because
  *	of MMIO cost involved in later method.
  */
@@ -303,6 +495,10 @@ static int sbi_tlb_update_cb(void *in, void *data)
 	curr = (struct sbi_tlb_info *)data;
 	next = (struct sbi_tlb_info *)in;
 
+	/* An entry completes at most one ticket, so tickets never merge */
+	if (curr->ticket || next->ticket)
+		return ret;
+
 	if (next->type == SBI_TLB_FLUSH_VMA_ASID &&
 	    curr->type == SBI_TLB_FLUSH_VMA_ASID) {
 		if (next->asid == curr->asid)
@@ -320,7 +516,9 @@ static int sbi_tlb_update(struct sbi_scratch *scratch,
 			  u32 remote_hartid, void *data)
 {
 	int ret;
-	struct sbi_fifo *tlb_fifo_r;
+	struct sbi_tlb_ring *tlb_ring_r;
+	struct sbi_tlb_sync *tlb_sync;
+	struct sbi_tlb_ticket *tlb_ticket;
 	struct sbi_tlb_info *tinfo = data;
 	u32 curr_hartid = sbi_current_hartid();
 
@@ -343,27 +541,38 @@ static int sbi_tlb_update(struct sbi_scratch *scratch,
 		return -1;
 	}
 
-	tlb_fifo_r = sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_off);
+	tlb_ring_r = sbi_scratch_offset_ptr(remote_scratch, tlb_ring_off);
 
-	ret = sbi_fifo_inplace_update(tlb_fifo_r, data, sbi_tlb_update_cb);
-	if (ret != SBI_FIFO_UNCHANGED) {
-		return 1;
+	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	tlb_ticket = sbi_scratch_offset_ptr(scratch, tlb_ticket_off);
+
+	/* Must be pending before the target can see and ack the request */
+	if (tinfo->ticket) {
+		atomic_raw_set_bit(remote_hartid, &tlb_ticket->pending[
+			SBI_TLB_TICKET_SLOT(tlb_ticket->seq + 1)]);
+	} else {
+		ret = sbi_tlb_ring_coalesce(tlb_ring_r, tinfo,
+					    sbi_tlb_update_cb);
+		if (ret != SBI_FIFO_UNCHANGED) {
+			tlb_sync->pending++;
+			return 1;
+		}
 	}
 
-	while (sbi_fifo_enqueue(tlb_fifo_r, data) < 0) {
+	while (sbi_tlb_ring_enqueue(tlb_ring_r, tinfo) < 0) {
 		/**
-		 * For now, Busy loop until there is space in the fifo.
-		 * There may be case where target hart is also
-		 * enqueue in source hart's fifo. Both hart may busy
-		 * loop leading to a deadlock.
-		 * TODO: Introduce a wait/wakeup event mechanism to handle
-		 * this properly.
+		 * Busy loop until there is space in the ring. The target
+		 * hart may be enqueueing in our ring at the same time so
+		 * keep draining our own ring to avoid a deadlock.
 		 */
 		sbi_tlb_process_count(scratch, 1);
-		sbi_dprintf(remote_scratch, "hart%d: hart%d tlb fifo full\n",
+		sbi_dprintf(remote_scratch, "hart%d: hart%d tlb ring full\n",
 			    curr_hartid, remote_hartid);
 	}
 
+	if (!tinfo->ticket)
+		tlb_sync->pending++;
+
 	return 0;
 }
 
@@ -379,40 +588,140 @@ static u32 tlb_event = SBI_IPI_EVENT_MAX;
 int sbi_tlb_request(struct sbi_scratch *scratch, ulong hmask,
 		    ulong hbase, struct sbi_tlb_info *tinfo)
 {
+	tinfo->ticket = 0;
+
 	return sbi_ipi_send_many(scratch, hmask, hbase, tlb_event, tinfo);
 }
 
+/**
+ * Queue a TLB request on remote HARTs without waiting for them
+ *
+ * The returned ticket holds the current HART in its low bits and the
+ * sequence number of the request in the remaining bits.
+ */
+int sbi_tlb_request_async(struct sbi_scratch *scratch, ulong hmask,
+			  ulong hbase, struct sbi_tlb_info *tinfo,
+			  unsigned long *ticket)
+{
+	int ret;
+	u32 hartid = sbi_current_hartid();
+	struct sbi_tlb_ticket *tlb_ticket =
+			sbi_scratch_offset_ptr(scratch, tlb_ticket_off);
+	unsigned long seq = tlb_ticket->seq + 1;
+	unsigned long slot = SBI_TLB_TICKET_SLOT(seq);
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	/* Pending target HARTs are tracked in a single word */
+	if (BITS_PER_LONG < sbi_platform_hart_count(plat))
+		return SBI_ENOTSUPP;
+
+	/* Wait for the oldest outstanding request if all slots are taken */
+	while (tlb_ticket->pending[slot])
+		sbi_tlb_process_count(scratch, 1);
+
+	tinfo->ticket = (seq << SBI_TLB_TICKET_HART_BITS) | hartid;
+	tinfo->shart_mask = 0;
+
+	tlb_ticket->slot_seq[slot] = seq;
+	tlb_ticket->async = 1;
+	ret = sbi_ipi_send_many(scratch, hmask, hbase, tlb_event, tinfo);
+	tlb_ticket->async = 0;
+
+	/* Publish the ticket only once all its targets are pending */
+	smp_wmb();
+	tlb_ticket->seq = seq;
+	*ticket = tinfo->ticket;
+
+	return ret;
+}
+
+static bool sbi_tlb_ticket_done(struct sbi_tlb_ticket *rticket,
+				unsigned long seq)
+{
+	unsigned long slot = SBI_TLB_TICKET_SLOT(seq);
+	unsigned long pending;
+
+	if (rticket->slot_seq[slot] != seq)
+		return TRUE;
+
+	pending = rticket->pending[slot];
+	smp_rmb();
+
+	/* The slot may have been reused since it was checked */
+	return !pending || rticket->slot_seq[slot] != seq;
+}
+
+/**
+ * Check or wait for completion of a ticket returned by
+ * sbi_tlb_request_async(). Tickets of any HART can be polled. Waiting
+ * gives up after SBI_TLB_TICKET_WAIT_SPINS rounds and reports the ticket
+ * as not done, so that S-mode gets a chance to take interrupts.
+ */
+int sbi_tlb_ticket_poll(struct sbi_scratch *scratch, unsigned long ticket,
+			bool wait, unsigned long *done)
+{
+	struct sbi_scratch *rscratch;
+	struct sbi_tlb_ticket *rticket;
+	u32 i, hartid = ticket & SBI_TLB_TICKET_HART_MASK;
+	unsigned long seq = ticket >> SBI_TLB_TICKET_HART_BITS;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (BITS_PER_LONG < sbi_platform_hart_count(plat))
+		return SBI_ENOTSUPP;
+	if (sbi_platform_hart_count(plat) <= hartid)
+		return SBI_EINVAL;
+
+	rscratch = sbi_hart_id_to_scratch(scratch, hartid);
+	rticket = sbi_scratch_offset_ptr(rscratch, tlb_ticket_off);
+	if (seq && (long)(rticket->seq - seq) < 0)
+		return SBI_EINVAL;
+
+	*done = 1;
+	if (!seq)
+		return 0;
+
+	for (i = 0; !sbi_tlb_ticket_done(rticket, seq); i++) {
+		if (!wait || i == SBI_TLB_TICKET_WAIT_SPINS) {
+			*done = 0;
+			break;
+		}
+		/* Keep serving our own ring to avoid deadlock */
+		sbi_tlb_process_count(scratch, 1);
+	}
+
+	return 0;
+}
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int ret;
-	void *tlb_mem;
-	unsigned long *tlb_sync;
-	struct sbi_fifo *tlb_q;
+	struct sbi_tlb_sync *tlb_sync;
+	struct sbi_tlb_ticket *tlb_ticket;
+	struct sbi_tlb_ring *tlb_ring;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync),
-							    "IPI_TLB_SYNC");
+		tlb_sync_off = sbi_scratch_alloc_cacheline_offset(
+					sizeof(*tlb_sync), "IPI_TLB_SYNC");
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q),
-							    "IPI_TLB_FIFO");
-		if (!tlb_fifo_off) {
+		tlb_ticket_off = sbi_scratch_alloc_cacheline_offset(
+					sizeof(*tlb_ticket), "IPI_TLB_TICKET");
+		if (!tlb_ticket_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
-		tlb_fifo_mem_off = sbi_scratch_alloc_offset(
-				SBI_TLB_FIFO_NUM_ENTRIES * SBI_TLB_INFO_SIZE,
-				"IPI_TLB_FIFO_MEM");
-		if (!tlb_fifo_mem_off) {
-			sbi_scratch_free_offset(tlb_fifo_off);
+		tlb_ring_off = sbi_scratch_alloc_cacheline_offset(
+					sizeof(*tlb_ring), "IPI_TLB_RING");
+		if (!tlb_ring_off) {
+			sbi_scratch_free_offset(tlb_ticket_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
 		ret = sbi_ipi_event_create(&tlb_ops);
 		if (ret < 0) {
-			sbi_scratch_free_offset(tlb_fifo_mem_off);
-			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_ring_off);
+			sbi_scratch_free_offset(tlb_ticket_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return ret;
 		}
@@ -420,21 +729,22 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 		tlb_range_flush_limit = sbi_platform_tlbr_flush_limit(plat);
 	} else {
 		if (!tlb_sync_off ||
-		    !tlb_fifo_off ||
-		    !tlb_fifo_mem_off)
+		    !tlb_ticket_off ||
+		    !tlb_ring_off)
 			return SBI_ENOMEM;
 		if (SBI_IPI_EVENT_MAX <= tlb_event)
 			return SBI_ENOSPC;
 	}
 
 	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
-	tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
-	tlb_mem = sbi_scratch_offset_ptr(scratch, tlb_fifo_mem_off);
+	tlb_ticket = sbi_scratch_offset_ptr(scratch, tlb_ticket_off);
+	tlb_ring = sbi_scratch_offset_ptr(scratch, tlb_ring_off);
 
-	*tlb_sync = 0;
+	tlb_sync->acked = 0;
+	tlb_sync->pending = 0;
+	sbi_memset(tlb_ticket, 0, sizeof(*tlb_ticket));
 
-	sbi_fifo_init(tlb_q, tlb_mem,
-		      SBI_TLB_FIFO_NUM_ENTRIES, SBI_TLB_INFO_SIZE);
+	sbi_tlb_ring_init(tlb_ring);
 
 	return 0;
 }
@@ -0,0 +1,185 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_penglai_sm.h>
+#include <sbi/sbi_platform.h>
+#include <sbi/sbi_pmp.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_secmem.h>
+#include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
+
+/** Per-HART trace state, kept in M-mode so S-mode cannot redirect writes */
+struct sbi_trace_state {
+	struct sbi_trace_ring *ring;
+	unsigned long entries;
+	unsigned long head;
+	unsigned long mask;
+};
+
+static unsigned long trace_state_off;
+/* Serializes buffer changes with memory being made secure */
+static spinlock_t trace_lock = SPIN_LOCK_INITIALIZER;
+
+static bool trace_ring_overlaps(struct sbi_scratch *scratch,
+				unsigned long base, unsigned long size)
+{
+	u32 i;
+	unsigned long rbase, rsize;
+	struct sbi_trace_state *ts;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	for (i = 0; i < sbi_platform_hart_count(plat); i++) {
+		ts = sbi_scratch_offset_ptr(sbi_hart_id_to_scratch(scratch, i),
+					    trace_state_off);
+		if (!ts->ring)
+			continue;
+		rbase = (unsigned long)ts->ring;
+		rsize = sizeof(struct sbi_trace_ring) +
+			ts->entries * sizeof(struct sbi_trace_record);
+		if (base < rbase + rsize && rbase < base + size)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Call fn on a range no trace buffer of any HART overlaps
+ *
+ * No trace can start meanwhile, so once fn has made the range secure
+ * M-mode never writes trace records into it. Returns SBI_DENIED if a
+ * buffer overlaps, otherwise the value returned by fn.
+ */
+int sbi_trace_exclude(struct sbi_scratch *scratch, unsigned long base,
+		      unsigned long size,
+		      int (*fn)(unsigned long base, unsigned long size))
+{
+	int rc;
+
+	if (!trace_state_off)
+		return fn(base, size);
+
+	spin_lock(&trace_lock);
+	if (trace_ring_overlaps(scratch, base, size))
+		rc = SBI_DENIED;
+	else
+		rc = fn(base, size);
+	spin_unlock(&trace_lock);
+
+	return rc;
+}
+
+/**
+ * Append a record to the trace buffer of the current HART
+ *
+ * Only the HART itself writes to its buffer and M-mode runs with
+ * interrupts disabled, so no locking is needed. Nothing but the enclave
+ * switches is recorded while an enclave runs, to not leak its activity
+ * to the host.
+ */
+void sbi_trace(struct sbi_scratch *scratch, u32 event, u32 info,
+	       unsigned long arg0, unsigned long arg1)
+{
+	struct sbi_trace_record *rec;
+	struct sbi_trace_state *ts;
+
+	if (!trace_state_off)
+		return;
+
+	ts = sbi_scratch_offset_ptr(scratch, trace_state_off);
+	if (!(ts->mask & (1UL << event)))
+		return;
+	if (event != SBI_TRACE_ENCLAVE && check_in_enclave_world() >= 0)
+		return;
+
+	rec = &ts->ring->records[ts->head & (ts->entries - 1)];
+	rec->time = sbi_timer_value(scratch);
+	rec->event = event;
+	rec->info = info;
+	rec->arg0 = arg0;
+	rec->arg1 = arg1;
+
+	smp_wmb();
+	ts->ring->head = ++ts->head;
+}
+
+int sbi_trace_start(struct sbi_scratch *scratch, unsigned long base,
+		    unsigned long size, unsigned long mask)
+{
+	unsigned long entries;
+	struct sbi_trace_state *ts;
+
+	if (!trace_state_off)
+		return SBI_ENOTSUPP;
+	if (!mask || (mask & ~SBI_TRACE_EVENT_ALL))
+		return SBI_EINVAL;
+	if ((base & (sizeof(struct sbi_trace_record) - 1)) ||
+	    size < sizeof(struct sbi_trace_ring) +
+		   sizeof(struct sbi_trace_record) ||
+	    base + size < base)
+		return SBI_EINVAL;
+
+	spin_lock(&trace_lock);
+
+	/* The host must not be able to point M-mode at protected memory */
+	if ((base < scratch->fw_start + scratch->fw_size &&
+	     scratch->fw_start < base + size) ||
+	    check_mem_overlap(base, size) ||
+	    sbi_secmem_overlaps_reserve(base, size) ||
+	    sbi_pmp_range_protected(scratch, base, size)) {
+		spin_unlock(&trace_lock);
+		return SBI_DENIED;
+	}
+
+	entries = (size - sizeof(struct sbi_trace_ring)) /
+		  sizeof(struct sbi_trace_record);
+	while (entries & (entries - 1))
+		entries &= entries - 1;
+
+	ts = sbi_scratch_offset_ptr(scratch, trace_state_off);
+	ts->mask = 0;
+	ts->ring = (struct sbi_trace_ring *)base;
+	ts->entries = entries;
+	ts->head = 0;
+	ts->ring->head = 0;
+	ts->ring->entries = entries;
+	ts->mask = mask;
+
+	spin_unlock(&trace_lock);
+
+	return 0;
+}
+
+void sbi_trace_stop(struct sbi_scratch *scratch)
+{
+	struct sbi_trace_state *ts;
+
+	if (!trace_state_off)
+		return;
+
+	spin_lock(&trace_lock);
+	ts = sbi_scratch_offset_ptr(scratch, trace_state_off);
+	ts->mask = 0;
+	ts->ring = NULL;
+	spin_unlock(&trace_lock);
+}
+
+int sbi_trace_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		trace_state_off = sbi_scratch_alloc_offset(
+					sizeof(struct sbi_trace_state),
+					"TRACE_STATE");
+		if (!trace_state_off)
+			return SBI_ENOMEM;
+	} else if (!trace_state_off)
+		return SBI_ENOMEM;
+
+	return 0;
+}
@@ -16,7 +16,9 @@
 #include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_misaligned_ldst.h>
+#include <sbi/sbi_penglai_sm.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_trace.h>
 #include <sbi/sbi_trap.h>
 
 static void __noreturn sbi_trap_error(const char *msg, int rc, u32 hartid,
@@ -195,7 +197,6 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
 	return 0;
 }
 
-extern int check_in_enclave_world();
 /**
  * Handle trap/interrupt
  *
@@ -218,17 +219,28 @@ void sbi_trap_handler(struct sbi_trap_regs *regs,
 {
 	int rc = SBI_ENOTSUPP;
 	const char *msg = "trap handler failed";
-	u32 hartid = sbi_current_hartid();
+	u32 hartid;
 	ulong mcause = csr_read(CSR_MCAUSE);
 	ulong mtval = csr_read(CSR_MTVAL), mtval2 = 0, mtinst = 0;
 	struct sbi_trap_info trap, *uptrap;
 
+	/* Counter reads are frequent enough to skip everything else */
+	if (mcause == CAUSE_ILLEGAL_INSTRUCTION &&
+	    !sbi_illegal_insn_counter_fast(mtval, regs, scratch))
+		return;
+
+	hartid = sbi_current_hartid();
+
 	//sbi_printf("[PenglaiMonitor@%s] begin with mepc: 0x%x\n", __func__, regs->mepc);
 	if (misa_extension('H')) {
 		mtval2 = csr_read(CSR_MTVAL2);
 		mtinst = csr_read(CSR_MTINST);
 	}
 
+	if (mcause != CAUSE_SUPERVISOR_ECALL &&
+	    mcause != CAUSE_HYPERVISOR_ECALL)
+		sbi_trace(scratch, SBI_TRACE_TRAP, 0, mcause, regs->mepc);
+
 	if (mcause & (1UL << (__riscv_xlen - 1))) {
 		mcause &= ~(1UL << (__riscv_xlen - 1));
 		switch (mcause) {
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Streaming enclave ELF loader
+ *
+ * The enclave binary is taken as a file descriptor and read through the
+ * page cache: every PT_LOAD segment is copied page by page from the
+ * cached file pages straight into the secure pages handed out by the
+ * sink. Nothing but the program headers is buffered, so loading needs
+ * O(chunk) kernel memory whatever the image size. Read-ahead of the next
+ * chunk is started before the current one is copied, which overlaps the
+ * disk I/O with the copy and with the monitor measuring loaded pages.
+ *
+ * The zero-filled tail of a segment past its last file page is never
+ * copied, it is reported to the sink as a zero range instead.
+ */
+
+#include <linux/elf.h>
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/slab.h>
+
+#include "penglai-enclave-elfstream.h"
+
+/* Pages read ahead of the copy */
+#define ELFSTREAM_CHUNK_PAGES	64
+/* Sanity bound on the program header table */
+#define ELFSTREAM_MAX_PHDRS	64
+
+static unsigned long elfstream_flags(const struct elf64_phdr *ph)
+{
+	return ph->p_flags & (PENGLAI_ELF_R | PENGLAI_ELF_W | PENGLAI_ELF_X);
+}
+
+/* Copy len bytes at file offset off out of the page cache */
+static int elfstream_copy(struct file *file, loff_t off, void *dst,
+			  size_t len)
+{
+	struct page *page;
+	size_t n, poff;
+	void *src;
+
+	while (len) {
+		page = read_mapping_page(file->f_mapping, off >> PAGE_SHIFT,
+					 file);
+		if (IS_ERR(page))
+			return PTR_ERR(page);
+
+		poff = offset_in_page(off);
+		n = min_t(size_t, len, PAGE_SIZE - poff);
+
+		src = kmap_atomic(page);
+		memcpy(dst, src + poff, n);
+		kunmap_atomic(src);
+		put_page(page);
+
+		dst += n;
+		off += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int elfstream_segment(struct file *file, const struct elf64_phdr *ph,
+			     const struct penglai_elf_sink *sink)
+{
+	unsigned long flags = elfstream_flags(ph);
+	unsigned long va = ph->p_vaddr & PAGE_MASK;
+	unsigned long file_end = ph->p_vaddr + ph->p_filesz;
+	unsigned long mem_end = PAGE_ALIGN(ph->p_vaddr + ph->p_memsz);
+	unsigned long start, end;
+	loff_t off, ra = ph->p_offset;
+	void *dst;
+	int ret;
+
+	/* Every page holding file bytes is copied, the rest is zero */
+	for (; va < file_end; va += PAGE_SIZE) {
+		start = max(va, (unsigned long)ph->p_vaddr);
+		end = min(va + PAGE_SIZE, file_end);
+		off = ph->p_offset + (start - ph->p_vaddr);
+
+		if (ra <= off) {
+			ra = off + ELFSTREAM_CHUNK_PAGES * PAGE_SIZE;
+			vfs_fadvise(file, off, ra - off, POSIX_FADV_WILLNEED);
+		}
+
+		dst = sink->page(sink->ctx, va, flags);
+		if (IS_ERR(dst))
+			return PTR_ERR(dst);
+
+		ret = elfstream_copy(file, off, dst + (start - va), end - start);
+		if (ret)
+			return ret;
+
+		cond_resched();
+	}
+
+	if (va < mem_end)
+		return sink->zero(sink->ctx, va, mem_end - va, flags);
+
+	return 0;
+}
+
+static int elfstream_check_ehdr(const struct elf64_hdr *eh)
+{
+	if (memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    eh->e_ident[EI_DATA] != ELFDATA2LSB ||
+	    eh->e_type != ET_EXEC || eh->e_machine != EM_RISCV ||
+	    eh->e_phentsize != sizeof(struct elf64_phdr) ||
+	    !eh->e_phnum || eh->e_phnum > ELFSTREAM_MAX_PHDRS)
+		return -ENOEXEC;
+
+	return 0;
+}
+
+static int elfstream_check_phdr(const struct elf64_phdr *ph, loff_t size)
+{
+	if (ph->p_filesz > ph->p_memsz ||
+	    ph->p_vaddr + ph->p_memsz < ph->p_vaddr ||
+	    ph->p_offset + ph->p_filesz < ph->p_offset ||
+	    ph->p_offset + ph->p_filesz > size)
+		return -ENOEXEC;
+
+	return 0;
+}
+
+/**
+ * penglai_elf_stream_load() - Load an enclave image from a file
+ * @fd:    Readable descriptor of the enclave ELF.
+ * @sink:  Where the loaded pages go.
+ * @entry: Entry point of the image.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_elf_stream_load(int fd, const struct penglai_elf_sink *sink,
+			    unsigned long *entry)
+{
+	struct elf64_phdr *phdrs = NULL;
+	struct elf64_hdr eh;
+	struct file *file;
+	loff_t pos = 0, size;
+	size_t len;
+	int i, ret;
+
+	file = fget(fd);
+	if (!file)
+		return -EBADF;
+
+	ret = -EINVAL;
+	if (!(file->f_mode & FMODE_READ) ||
+	    !S_ISREG(file_inode(file)->i_mode))
+		goto out;
+	size = i_size_read(file_inode(file));
+
+	ret = kernel_read(file, &eh, sizeof(eh), &pos);
+	if (ret >= 0)
+		ret = ret == sizeof(eh) ? elfstream_check_ehdr(&eh) : -ENOEXEC;
+	if (ret)
+		goto out;
+
+	len = eh.e_phnum * sizeof(*phdrs);
+	phdrs = kmalloc(len, GFP_KERNEL);
+	if (!phdrs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	pos = eh.e_phoff;
+	ret = kernel_read(file, phdrs, len, &pos);
+	if (ret >= 0)
+		ret = ret == len ? 0 : -ENOEXEC;
+	if (ret)
+		goto out;
+
+	for (i = 0; i < eh.e_phnum; i++) {
+		if (phdrs[i].p_type != PT_LOAD || !phdrs[i].p_memsz)
+			continue;
+
+		ret = elfstream_check_phdr(&phdrs[i], size);
+		if (!ret)
+			ret = elfstream_segment(file, &phdrs[i], sink);
+		if (ret)
+			goto out;
+	}
+
+	*entry = eh.e_entry;
+
+out:
+	kfree(phdrs);
+	fput(file);
+	return ret;
+}
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _PENGLAI_ENCLAVE_ELFSTREAM_H
+#define _PENGLAI_ENCLAVE_ELFSTREAM_H
+
+#include <linux/types.h>
+
+/* Segment permissions passed to the sink, same bits as p_flags */
+#define PENGLAI_ELF_X		0x1
+#define PENGLAI_ELF_W		0x2
+#define PENGLAI_ELF_R		0x4
+
+/**
+ * struct penglai_elf_sink - Destination of a streamed enclave image
+ * @page: Return the kernel mapping of the enclave page at @va, donating
+ *        secure memory as needed, or an ERR_PTR(). A page is zero the
+ *        first time it is returned; segments sharing a page get the same
+ *        mapping again, also when it was part of an earlier zero range.
+ * @zero: Record the page aligned range [@va, @va + @len) as zero filled.
+ *        The monitor backs it with fresh zeroed pages, nothing is copied.
+ */
+struct penglai_elf_sink {
+	void *(*page)(void *ctx, unsigned long va, unsigned long flags);
+	int (*zero)(void *ctx, unsigned long va, unsigned long len,
+		    unsigned long flags);
+	void *ctx;
+};
+
+int penglai_elf_stream_load(int fd, const struct penglai_elf_sink *sink,
+			    unsigned long *entry);
+
+#endif
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Dedicated enclave harts
+ *
+ * A CPU is taken offline through the normal hotplug path, which stops
+ * its hart with SBI HSM, and is then handed to the monitor to run one
+ * enclave only. Host ticks and IPIs no longer reach it, so the enclave
+ * is never preempted by the host. Releasing the hart gives it back to
+ * the monitor's stopped pool and the CPU is brought online again.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/mutex.h>
+#include <asm/sbi.h>
+#include <asm/smp.h>
+
+#include "penglai-enclave-hart.h"
+
+/* Must match opensbi include/sbi/sbi_ecall_interface.h */
+#define SBI_EXT_PENGLAI		0x09000000
+#define SBI_HART_ASSIGN		79
+#define SBI_HART_RELEASE	78
+
+static DEFINE_MUTEX(hart_lock);
+static struct cpumask hart_assigned;
+
+static unsigned long penglai_cpu_to_hartid(unsigned int cpu)
+{
+	struct cpumask hmask;
+
+	riscv_cpuid_to_hartid_mask(cpumask_of(cpu), &hmask);
+
+	return cpumask_first(&hmask);
+}
+
+/**
+ * penglai_hart_assign() - Dedicate a CPU to an enclave
+ * @cpu: Online CPU to take away from the host, not the boot CPU.
+ * @eid: Enclave that runs on it.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_hart_assign(unsigned int cpu, unsigned long eid)
+{
+	struct sbiret ret;
+	int err;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	mutex_lock(&hart_lock);
+	if (cpumask_test_cpu(cpu, &hart_assigned)) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	err = remove_cpu(cpu);
+	if (err)
+		goto out;
+
+	ret = sbi_ecall(SBI_EXT_PENGLAI, SBI_HART_ASSIGN,
+			penglai_cpu_to_hartid(cpu), eid, 0, 0, 0, 0);
+	if (ret.error) {
+		err = sbi_err_map_linux_errno(ret.error);
+		add_cpu(cpu);
+		goto out;
+	}
+
+	cpumask_set_cpu(cpu, &hart_assigned);
+
+out:
+	mutex_unlock(&hart_lock);
+	return err;
+}
+
+/**
+ * penglai_hart_release() - Give a dedicated CPU back to the host
+ * @cpu: CPU passed to penglai_hart_assign().
+ *
+ * The enclave thread running there is moved off by the monitor and can
+ * be resumed on a shared CPU.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_hart_release(unsigned int cpu)
+{
+	struct sbiret ret;
+	int err = 0;
+
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	mutex_lock(&hart_lock);
+	if (!cpumask_test_cpu(cpu, &hart_assigned)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	ret = sbi_ecall(SBI_EXT_PENGLAI, SBI_HART_RELEASE,
+			penglai_cpu_to_hartid(cpu), 0, 0, 0, 0, 0);
+	if (ret.error) {
+		err = sbi_err_map_linux_errno(ret.error);
+		goto out;
+	}
+
+	cpumask_clear_cpu(cpu, &hart_assigned);
+	err = add_cpu(cpu);
+
+out:
+	mutex_unlock(&hart_lock);
+	return err;
+}
+
+void penglai_hart_exit(void)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &hart_assigned)
+		penglai_hart_release(cpu);
+}
@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _PENGLAI_ENCLAVE_HART_H
+#define _PENGLAI_ENCLAVE_HART_H
+
+int penglai_hart_assign(unsigned int cpu, unsigned long eid);
+int penglai_hart_release(unsigned int cpu);
+void penglai_hart_exit(void);
+
+#endif
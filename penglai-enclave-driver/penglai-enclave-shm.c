@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Shared regions between enclaves and their host
+ *
+ * The driver allocates physically contiguous host memory and registers
+ * it with the monitor as a named region. The monitor maps it into the
+ * enclaves it is granted to, and the host process maps the very same
+ * pages through mmap() on the enclave device, so payloads move between
+ * host, parser and crypto enclaves without a single copy.
+ *
+ * A region is mmap()ed with the offset set to its id in pages, and only
+ * through the file that created it. The pages stay allocated until the
+ * region is destroyed and the last host mapping is gone.
+ */
+
+#include <linux/gfp.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/xarray.h>
+#include <asm/sbi.h>
+
+#include "penglai-enclave-shm.h"
+
+/* Must match opensbi include/sbi/sbi_ecall_interface.h */
+#define SBI_EXT_PENGLAI		0x09000000
+#define SBI_SHM_CREATE		83
+#define SBI_SHM_GRANT		82
+#define SBI_SHM_REVOKE		81
+#define SBI_SHM_DESTROY		80
+
+struct penglai_shm {
+	struct kref ref;
+	struct page *pages;
+	unsigned int order;
+	unsigned long size;
+	/* File the region was created through */
+	const void *owner;
+};
+
+/* Regions by monitor id */
+static DEFINE_XARRAY(shm_regions);
+/*
+ * Serializes monitor create and destroy with the xarray updates, so that
+ * an id freed by the monitor is out of the xarray before it is reused.
+ */
+static DEFINE_MUTEX(shm_mutex);
+
+static void shm_release(struct kref *ref)
+{
+	struct penglai_shm *shm = container_of(ref, struct penglai_shm, ref);
+
+	__free_pages(shm->pages, shm->order);
+	kfree(shm);
+}
+
+/**
+ * penglai_shm_create() - Allocate a region and register it with the monitor
+ * @key:   Name of the region, unique among live regions.
+ * @size:  Size in bytes, rounded up to whole pages.
+ * @owner: File the region is created through, the only one allowed to
+ *         mmap() or destroy it.
+ * @id:    Monitor id of the region, used for grants and mmap().
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_shm_create(unsigned long key, unsigned long size,
+		       const void *owner, unsigned long *id)
+{
+	struct penglai_shm *shm;
+	struct sbiret ret;
+	int err;
+
+	if (!size)
+		return -EINVAL;
+
+	shm = kzalloc(sizeof(*shm), GFP_KERNEL);
+	if (!shm)
+		return -ENOMEM;
+
+	kref_init(&shm->ref);
+	shm->owner = owner;
+	shm->size = PAGE_ALIGN(size);
+	shm->order = get_order(shm->size);
+	shm->pages = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN,
+				 shm->order);
+	if (!shm->pages) {
+		kfree(shm);
+		return -ENOMEM;
+	}
+
+	mutex_lock(&shm_mutex);
+
+	ret = sbi_ecall(SBI_EXT_PENGLAI, SBI_SHM_CREATE, key,
+			page_to_phys(shm->pages), shm->size, 0, 0, 0);
+	if (ret.error) {
+		err = sbi_err_map_linux_errno(ret.error);
+		goto fail;
+	}
+
+	err = xa_insert(&shm_regions, ret.value, shm, GFP_KERNEL);
+	if (err) {
+		sbi_ecall(SBI_EXT_PENGLAI, SBI_SHM_DESTROY, ret.value,
+			  0, 0, 0, 0, 0);
+		goto fail;
+	}
+
+	mutex_unlock(&shm_mutex);
+	*id = ret.value;
+
+	return 0;
+
+fail:
+	mutex_unlock(&shm_mutex);
+	kref_put(&shm->ref, shm_release);
+	return err;
+}
+
+/**
+ * penglai_shm_grant() - Map a region into an enclave
+ * @id:   Region id.
+ * @eid:  Enclave id.
+ * @prot: PENGLAI_SHM_READ and/or PENGLAI_SHM_WRITE.
+ * @va:   Address of the region in the enclave.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_shm_grant(unsigned long id, unsigned long eid, unsigned long prot,
+		      unsigned long *va)
+{
+	struct sbiret ret;
+
+	ret = sbi_ecall(SBI_EXT_PENGLAI, SBI_SHM_GRANT, id, eid, prot,
+			0, 0, 0);
+	if (ret.error)
+		return sbi_err_map_linux_errno(ret.error);
+
+	*va = ret.value;
+
+	return 0;
+}
+
+/**
+ * penglai_shm_revoke() - Unmap a region from an enclave
+ * @id:  Region id.
+ * @eid: Enclave id.
+ *
+ * The enclave can no longer reach the region once this returns.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_shm_revoke(unsigned long id, unsigned long eid)
+{
+	struct sbiret ret;
+
+	ret = sbi_ecall(SBI_EXT_PENGLAI, SBI_SHM_REVOKE, id, eid, 0, 0, 0, 0);
+
+	return ret.error ? sbi_err_map_linux_errno(ret.error) : 0;
+}
+
+/**
+ * penglai_shm_destroy() - Unregister a region
+ * @id:    Region id.
+ * @owner: File the region was created through.
+ *
+ * Fails with -EPERM while an enclave still holds a grant. Host mappings
+ * keep the pages alive until they are unmapped.
+ *
+ * Return: 0 on success, negative errno on failure.
+ */
+int penglai_shm_destroy(unsigned long id, const void *owner)
+{
+	struct penglai_shm *shm;
+	struct sbiret ret;
+	int err = 0;
+
+	mutex_lock(&shm_mutex);
+
+	shm = xa_load(&shm_regions, id);
+	if (!shm) {
+		err = -ENOENT;
+		goto out;
+	}
+	if (shm->owner != owner) {
+		err = -EACCES;
+		goto out;
+	}
+
+	ret = sbi_ecall(SBI_EXT_PENGLAI, SBI_SHM_DESTROY, id, 0, 0, 0, 0, 0);
+	if (ret.error) {
+		err = sbi_err_map_linux_errno(ret.error);
+		goto out;
+	}
+
+	xa_erase(&shm_regions, id);
+	kref_put(&shm->ref, shm_release);
+
+out:
+	mutex_unlock(&shm_mutex);
+	return err;
+}
+
+static void shm_vm_open(struct vm_area_struct *vma)
+{
+	struct penglai_shm *shm = vma->vm_private_data;
+
+	kref_get(&shm->ref);
+}
+
+static void shm_vm_close(struct vm_area_struct *vma)
+{
+	struct penglai_shm *shm = vma->vm_private_data;
+
+	kref_put(&shm->ref, shm_release);
+}
+
+static const struct vm_operations_struct shm_vm_ops = {
+	.open = shm_vm_open,
+	.close = shm_vm_close,
+};
+
+/**
+ * penglai_shm_mmap() - Map a region into the calling process
+ * @owner: File the mmap() is made through.
+ * @vma:   Mapping with vm_pgoff set to the region id.
+ *
+ * Return: 0 on success, -EACCES if the region was created through another
+ * file, other negative errno on failure.
+ */
+int penglai_shm_mmap(const void *owner, struct vm_area_struct *vma)
+{
+	struct penglai_shm *shm;
+	unsigned long len = vma->vm_end - vma->vm_start;
+	int err;
+
+	xa_lock(&shm_regions);
+	shm = xa_load(&shm_regions, vma->vm_pgoff);
+	if (shm)
+		kref_get(&shm->ref);
+	xa_unlock(&shm_regions);
+
+	if (!shm)
+		return -ENOENT;
+
+	if (shm->owner != owner) {
+		err = -EACCES;
+		goto fail;
+	}
+
+	if (len > shm->size) {
+		err = -EINVAL;
+		goto fail;
+	}
+
+	vma->vm_flags |= VM_IO | VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	err = remap_pfn_range(vma, vma->vm_start, page_to_pfn(shm->pages),
+			      len, vma->vm_page_prot);
+	if (err)
+		goto fail;
+
+	vma->vm_private_data = shm;
+	vma->vm_ops = &shm_vm_ops;
+
+	return 0;
+
+fail:
+	kref_put(&shm->ref, shm_release);
+	return err;
+}
+
+/* Regions still registered on unload are leaked to the monitor */
+void penglai_shm_exit(void)
+{
+	struct penglai_shm *shm;
+	unsigned long id;
+
+	xa_for_each(&shm_regions, id, shm) {
+		if (penglai_shm_destroy(id, shm->owner))
+			pr_warn("penglai: shared region %lu still granted\n",
+				id);
+	}
+}
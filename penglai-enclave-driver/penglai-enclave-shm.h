@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _PENGLAI_ENCLAVE_SHM_H
+#define _PENGLAI_ENCLAVE_SHM_H
+
+#include <linux/mm_types.h>
+#include <linux/types.h>
+
+/* Must match opensbi include/sbi/sbi_penglai_shm.h */
+#define PENGLAI_SHM_READ	0x1
+#define PENGLAI_SHM_WRITE	0x2
+
+int penglai_shm_create(unsigned long key, unsigned long size,
+		       const void *owner, unsigned long *id);
+int penglai_shm_grant(unsigned long id, unsigned long eid, unsigned long prot,
+		      unsigned long *va);
+int penglai_shm_revoke(unsigned long id, unsigned long eid);
+int penglai_shm_destroy(unsigned long id, const void *owner);
+
+int penglai_shm_mmap(const void *owner, struct vm_area_struct *vma);
+
+void penglai_shm_exit(void);
+
+#endif
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Switchless OCALLs
+ *
+ * Host worker threads poll the OCALL rings of running enclaves and
+ * complete the posted requests while the enclave keeps running, so
+ * the enclave never has to leave for them. Each ring is served by a
+ * single worker to keep it single producer, single consumer.
+ *
+ * The workers are started by the first penglai_switchless_attach() and
+ * stay up until the module is unloaded.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/timex.h>
+
+#include "penglai-enclave-switchless.h"
+
+static unsigned int switchless_workers = 1;
+module_param(switchless_workers, uint, 0444);
+MODULE_PARM_DESC(switchless_workers,
+		 "Number of pinned host workers serving switchless OCALLs");
+
+static unsigned int switchless_spin_us = 50;
+module_param(switchless_spin_us, uint, 0644);
+MODULE_PARM_DESC(switchless_spin_us,
+		 "Idle time a worker keeps spinning before it starts sleeping");
+
+#define SWITCHLESS_SLEEP_MIN_US		50
+#define SWITCHLESS_SLEEP_MAX_US		2000
+#define SWITCHLESS_HIST_BUCKETS		32
+
+struct switchless_worker {
+	struct task_struct *task;
+	spinlock_t lock;
+	struct list_head rings;
+	unsigned int nr_rings;
+	/* Post to completion latency, bucket b counts [2^b, 2^(b+1)) ns */
+	u64 hist[SWITCHLESS_HIST_BUCKETS];
+};
+
+struct penglai_switchless {
+	struct list_head node;
+	struct ocall_ring *ring;
+	struct switchless_worker *worker;
+	/* Host copy of the ring tail, the shared one is never read back */
+	u64 tail;
+	/* Set once the enclave corrupted the ring, which is then ignored */
+	bool broken;
+};
+
+static DEFINE_MUTEX(switchless_lock);
+static struct switchless_worker *workers;
+static unsigned int nr_workers;
+static struct dentry *switchless_dir;
+
+static s64 switchless_handle(const struct ocall_ring_entry *e,
+			     const unsigned char *data)
+{
+	switch (e->nr) {
+	case OCALL_NR_WRITE:
+		pr_info("%.*s", (int)e->data_len, data);
+		return e->data_len;
+	default:
+		return -ENOSYS;
+	}
+}
+
+/* Both sides read the same time CSR, a posted time ahead of ours is bogus */
+static void switchless_account(struct switchless_worker *w, u64 post_time)
+{
+	s64 ticks = get_cycles() - post_time;
+	u64 ns;
+	unsigned int b;
+
+	if (ticks <= 0)
+		return;
+
+	ns = mul_u64_u32_div(ticks, NSEC_PER_SEC, riscv_timebase);
+	b = ns ? ilog2(ns) : 0;
+
+	if (b >= SWITCHLESS_HIST_BUCKETS)
+		b = SWITCHLESS_HIST_BUCKETS - 1;
+	WRITE_ONCE(w->hist[b], w->hist[b] + 1);
+}
+
+/*
+ * The ring lives in memory the enclave can write at any time, so every
+ * field is read exactly once into host memory before it is checked, and
+ * at most OCALL_RING_ENTRIES requests are served per call.
+ */
+static unsigned int switchless_drain(struct switchless_worker *w,
+				     struct penglai_switchless *sl)
+{
+	struct ocall_ring *ring = sl->ring;
+	struct ocall_ring_entry *e, ent;
+	u64 head = READ_ONCE(ring->head);
+	unsigned int n = 0;
+	s64 ret;
+
+	if (sl->broken)
+		return 0;
+	if (head - sl->tail > OCALL_RING_ENTRIES) {
+		pr_warn_ratelimited("penglai: bad OCALL ring head %llu tail %llu\n",
+				    head, sl->tail);
+		sl->broken = true;
+		return 0;
+	}
+
+	/* Read the entries only after the enclave published them */
+	smp_rmb();
+	while (sl->tail != head) {
+		e = &ring->entries[sl->tail % OCALL_RING_ENTRIES];
+		ent.nr = READ_ONCE(e->nr);
+		ent.arg0 = READ_ONCE(e->arg0);
+		ent.data_off = READ_ONCE(e->data_off);
+		ent.data_len = READ_ONCE(e->data_len);
+		ent.post_time = READ_ONCE(e->post_time);
+
+		if (ent.data_off > OCALL_RING_DATA_SIZE ||
+		    ent.data_len > OCALL_RING_DATA_SIZE - ent.data_off)
+			ret = -EINVAL;
+		else
+			ret = switchless_handle(&ent, ring->data + ent.data_off);
+		WRITE_ONCE(e->ret, ret);
+
+		switchless_account(w, ent.post_time);
+
+		/* The result must be visible before the slot is released */
+		smp_wmb();
+		WRITE_ONCE(ring->tail, ++sl->tail);
+		n++;
+	}
+
+	return n;
+}
+
+static int switchless_worker_fn(void *data)
+{
+	struct switchless_worker *w = data;
+	struct penglai_switchless *sl;
+	unsigned long sleep_us = SWITCHLESS_SLEEP_MIN_US;
+	ktime_t idle_since = ktime_get();
+	unsigned int n;
+
+	while (!kthread_should_stop()) {
+		n = 0;
+		spin_lock(&w->lock);
+		list_for_each_entry(sl, &w->rings, node)
+			n += switchless_drain(w, sl);
+		spin_unlock(&w->lock);
+
+		if (n) {
+			idle_since = ktime_get();
+			sleep_us = SWITCHLESS_SLEEP_MIN_US;
+			cond_resched();
+			continue;
+		}
+
+		if (ktime_us_delta(ktime_get(), idle_since) <
+		    READ_ONCE(switchless_spin_us)) {
+			cpu_relax();
+			cond_resched();
+			continue;
+		}
+
+		/* Idle for longer than the spin budget, back off */
+		usleep_range(sleep_us, sleep_us * 2);
+		sleep_us = min_t(unsigned long, sleep_us * 2,
+				 SWITCHLESS_SLEEP_MAX_US);
+	}
+
+	return 0;
+}
+
+static int switchless_latency_show(struct seq_file *m, void *v)
+{
+	unsigned int i, b;
+	u64 count;
+
+	for (i = 0; i < nr_workers; i++) {
+		seq_printf(m, "worker %u (rings %u):\n", i,
+			   READ_ONCE(workers[i].nr_rings));
+		for (b = 0; b < SWITCHLESS_HIST_BUCKETS; b++) {
+			count = READ_ONCE(workers[i].hist[b]);
+			if (count)
+				seq_printf(m, "  %12llu ns: %llu\n",
+					   1ULL << b, count);
+		}
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(switchless_latency);
+
+static void switchless_stop(void)
+{
+	unsigned int i;
+
+	debugfs_remove_recursive(switchless_dir);
+	switchless_dir = NULL;
+
+	for (i = 0; i < nr_workers; i++)
+		if (workers[i].task)
+			kthread_stop(workers[i].task);
+
+	kfree(workers);
+	workers = NULL;
+	nr_workers = 0;
+}
+
+static int switchless_start(void)
+{
+	struct switchless_worker *w;
+	unsigned int i, cpu;
+	int ret;
+
+	nr_workers = min(switchless_workers, num_online_cpus());
+	if (!nr_workers)
+		return 0;
+
+	workers = kcalloc(nr_workers, sizeof(*workers), GFP_KERNEL);
+	if (!workers) {
+		nr_workers = 0;
+		return -ENOMEM;
+	}
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < nr_workers; i++) {
+		w = &workers[i];
+		spin_lock_init(&w->lock);
+		INIT_LIST_HEAD(&w->rings);
+
+		w->task = kthread_create(switchless_worker_fn, w,
+					 "penglai-sl/%u", i);
+		if (IS_ERR(w->task)) {
+			ret = PTR_ERR(w->task);
+			w->task = NULL;
+			goto err;
+		}
+		kthread_bind(w->task, cpu);
+		wake_up_process(w->task);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	switchless_dir = debugfs_create_dir("penglai", NULL);
+	debugfs_create_file("switchless_latency", 0444, switchless_dir, NULL,
+			    &switchless_latency_fops);
+
+	return 0;
+
+err:
+	switchless_stop();
+	return ret;
+}
+
+/**
+ * penglai_switchless_attach() - Serve an enclave OCALL ring from a worker
+ * @ring: Kernel mapping of the ring in the enclave untrusted buffer.
+ *
+ * Return: attachment handle, or an ERR_PTR() on failure.
+ */
+struct penglai_switchless *penglai_switchless_attach(struct ocall_ring *ring)
+{
+	struct penglai_switchless *sl;
+	struct switchless_worker *w;
+	unsigned int i;
+	int err = 0;
+
+	mutex_lock(&switchless_lock);
+	if (!workers)
+		err = switchless_start();
+	if (!err && !nr_workers)
+		err = -ENODEV;
+	mutex_unlock(&switchless_lock);
+	if (err)
+		return ERR_PTR(err);
+
+	sl = kzalloc(sizeof(*sl), GFP_KERNEL);
+	if (!sl)
+		return ERR_PTR(-ENOMEM);
+
+	/* Pick the least loaded worker */
+	w = &workers[0];
+	for (i = 1; i < nr_workers; i++)
+		if (READ_ONCE(workers[i].nr_rings) < READ_ONCE(w->nr_rings))
+			w = &workers[i];
+
+	sl->ring = ring;
+	sl->worker = w;
+	sl->tail = READ_ONCE(ring->tail);
+
+	spin_lock(&w->lock);
+	list_add_tail(&sl->node, &w->rings);
+	w->nr_rings++;
+	spin_unlock(&w->lock);
+
+	return sl;
+}
+
+/**
+ * penglai_switchless_detach() - Stop serving an enclave OCALL ring
+ * @sl: Handle returned by penglai_switchless_attach().
+ *
+ * The ring is no longer accessed once this returns.
+ */
+void penglai_switchless_detach(struct penglai_switchless *sl)
+{
+	struct switchless_worker *w;
+
+	if (IS_ERR_OR_NULL(sl))
+		return;
+
+	w = sl->worker;
+	spin_lock(&w->lock);
+	list_del(&sl->node);
+	w->nr_rings--;
+	spin_unlock(&w->lock);
+
+	kfree(sl);
+}
+
+/* Called on module unload, once every ring has been detached */
+void penglai_switchless_exit(void)
+{
+	mutex_lock(&switchless_lock);
+	switchless_stop();
+	mutex_unlock(&switchless_lock);
+}
@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _PENGLAI_ENCLAVE_SWITCHLESS_H
+#define _PENGLAI_ENCLAVE_SWITCHLESS_H
+
+#include <linux/types.h>
+
+/* Must match penglai-sdk musl/src/internal/ocall_ring.h */
+#define OCALL_NR_WRITE		88
+
+#define OCALL_RING_OFFSET	0x1000
+#define OCALL_RING_ENTRIES	32
+#define OCALL_RING_DATA_SIZE	2048
+
+struct ocall_ring_entry {
+	u64 nr;
+	u64 arg0;
+	u64 data_off;
+	u64 data_len;
+	s64 ret;
+	/* time CSR when the enclave posted the entry */
+	u64 post_time;
+};
+
+struct ocall_ring {
+	u64 head;
+	u64 tail;
+	u64 data_used;
+	struct ocall_ring_entry entries[OCALL_RING_ENTRIES];
+	unsigned char data[OCALL_RING_DATA_SIZE];
+};
+
+struct penglai_switchless;
+
+struct penglai_switchless *penglai_switchless_attach(struct ocall_ring *ring);
+void penglai_switchless_detach(struct penglai_switchless *sl);
+
+void penglai_switchless_exit(void);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef OCALL_RING_H
+#define OCALL_RING_H
+
+/* OCALL ring
+ *
+ * The enclave posts write()/read()-style requests into a ring kept in
+ * the untrusted shared buffer, and the host completes them in order,
+ * advancing tail. There is one producer (the enclave) and one consumer
+ * (the host), so head and tail are each written by a single side.
+ *
+ * The layout must match penglai-enclave-driver/penglai-enclave-switchless.h */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef OCALL_NR_WRITE
+#define OCALL_NR_WRITE         88
+#endif
+
+#define OCALL_RING_OFFSET      0x1000
+#define OCALL_RING_ENTRIES     32
+#define OCALL_RING_DATA_SIZE   2048
+
+struct ocall_ring_entry {
+	uint64_t nr;
+	uint64_t arg0;
+	uint64_t data_off;
+	uint64_t data_len;
+	int64_t ret;
+	/* time CSR when the entry was posted */
+	uint64_t post_time;
+};
+
+struct ocall_ring {
+	uint64_t head;
+	uint64_t tail;
+	uint64_t data_used;
+	struct ocall_ring_entry entries[OCALL_RING_ENTRIES];
+	unsigned char data[OCALL_RING_DATA_SIZE];
+};
+
+/* Same as src/include/stdio.h */
+#ifndef DEFAULT_UNTRUSTED_PTR
+#define DEFAULT_UNTRUSTED_PTR  0x0000001000000000
+#endif
+
+#define OCALL_RING_PTR \
+	((struct ocall_ring *)(DEFAULT_UNTRUSTED_PTR + OCALL_RING_OFFSET))
+
+static inline int ocall_ring_pending(struct ocall_ring *r)
+{
+	return r->head != __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+/* Reset the data area once the host has drained every entry. */
+static inline void ocall_ring_reclaim(struct ocall_ring *r)
+{
+	if (!ocall_ring_pending(r)) r->data_used = 0;
+}
+
+/* Post a request with len bytes of payload and return its entry, or
+ * 0 if the ring or its data area is full. If buf is non-null the
+ * payload is copied in (write-style), otherwise the space is left for
+ * the host to fill (read-style). */
+static inline struct ocall_ring_entry *ocall_ring_post(struct ocall_ring *r,
+	uint64_t nr, uint64_t arg0, const void *buf, size_t len)
+{
+	struct ocall_ring_entry *e;
+	uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+	ocall_ring_reclaim(r);
+	if (r->head - tail >= OCALL_RING_ENTRIES) return 0;
+	if (len > OCALL_RING_DATA_SIZE - r->data_used) return 0;
+
+	e = &r->entries[r->head % OCALL_RING_ENTRIES];
+	e->nr = nr;
+	e->arg0 = arg0;
+	e->data_off = r->data_used;
+	e->data_len = len;
+	e->ret = 0;
+	__asm__ __volatile__ ("rdtime %0" : "=r"(e->post_time));
+	if (buf) memcpy(r->data + r->data_used, buf, len);
+	r->data_used += len;
+
+	/* The entry must be complete before the host can see it */
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+	return e;
+}
+
+#endif